@@ -0,0 +1,81 @@
+// Parallel algorithms against their sequential standard library counterparts.
+//
+// Each algorithm runs on the same random input of 32 bit integers, once sequentially and once
+// on a thread pool with a worker per CPU. The best of a few runs is reported.
+//
+// Usage: bench_algorithms [sizes...], e.g. bench_algorithms 1000000 1000000000
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <vector>
+#include <cppjobs/algorithms.hpp>
+#include <cppjobs/schedulers/thread_pool_scheduler.hpp>
+
+using namespace cppjobs;
+using clock_type = std::chrono::steady_clock;
+
+
+template <class Prepare, class Run>
+double best_ms(size_t runs, Prepare prepare, Run run) {
+	double best = std::numeric_limits<double>::max();
+	for (size_t i = 0; i < runs; ++i) {
+		prepare();
+		const auto start = clock_type::now();
+		run();
+		best = std::min(best, std::chrono::duration<double, std::milli>(clock_type::now() - start).count());
+	}
+	return best;
+}
+
+
+void report(const char* name, size_t size, double sequential, double parallel) {
+	std::printf("%-10s %12zu %14.2f %14.2f %9.2fx\n", name, size, sequential, parallel, sequential / parallel);
+}
+
+
+int main(int argc, char* argv[]) {
+	std::vector<size_t> sizes;
+	for (int i = 1; i < argc; ++i) {
+		sizes.push_back(std::strtoull(argv[i], nullptr, 10));
+	}
+	if (sizes.empty()) {
+		sizes = { 1'000'000, 10'000'000 };
+	}
+
+	auto sched = std::make_shared<thread_pool_scheduler>();
+	std::printf("%zu workers\n", sched->num_workers());
+	std::printf("%-10s %12s %14s %14s %10s\n", "algorithm", "size", "std [ms]", "cppjobs [ms]", "speedup");
+
+	for (size_t size : sizes) {
+		const size_t runs = size <= 10'000'000 ? 5 : 1;
+		std::vector<int> input(size);
+		std::mt19937 rng(42);
+		std::ranges::generate(input, [&rng] { return int(rng() % 1'000'000); });
+		std::vector<int> data;
+		std::vector<int> output(size);
+		const auto reset = [&] { data = input; };
+		const auto nothing = [] {};
+		const auto is_even = [](int value) { return value % 2 == 0; };
+		const auto scale = [](int value) { return value * 3 + 1; };
+
+		report("sort", size,
+			   best_ms(runs, reset, [&] { std::stable_sort(data.begin(), data.end()); }),
+			   best_ms(runs, reset, [&] { algorithms::sort(sched, data).get(); }));
+		report("transform", size,
+			   best_ms(runs, nothing, [&] { std::transform(input.begin(), input.end(), output.begin(), scale); }),
+			   best_ms(runs, nothing, [&] { algorithms::transform(sched, input, output.begin(), scale).get(); }));
+		report("scan", size,
+			   best_ms(runs, nothing, [&] { std::inclusive_scan(input.begin(), input.end(), output.begin()); }),
+			   best_ms(runs, nothing, [&] { algorithms::inclusive_scan(sched, input, output.begin()).get(); }));
+		report("partition", size,
+			   best_ms(runs, reset, [&] { std::stable_partition(data.begin(), data.end(), is_even); }),
+			   best_ms(runs, reset, [&] { algorithms::partition(sched, data, is_even).get(); }));
+	}
+	return 0;
+}
@@ -0,0 +1,360 @@
+// The same workloads on cppjobs and on the standard library.
+//
+// fan_out    A binary tree of tasks, each node starts two children and waits for them.
+//            std::async starts a thread per task, so its rows have no thread count (0).
+// ping_pong  A task hands a request to another task and waits for the answer, one at a time.
+//            std::thread passes it between two threads through a condition variable.
+// counter    Every thread increments a shared counter under a mutex.
+// read_map   Every thread looks up keys of a shared map under a shared mutex, and updates one
+//            in every 20 operations under the exclusive lock.
+//
+// For each workload and library there are two rows. The first is the time per operation
+// averaged over each round, the inverse of throughput. The second, marked latency, is the
+// distribution of a whole tree for fan_out, of a round trip for ping_pong, and of taking the lock
+// for the others. The pool is created up front, but std threads are started inside the timed part,
+// as that's what using them costs.
+//
+// Usage: bench_compare [--json] [--filter=TEXT] [--threads=N] [--rounds=N] [--no-counters]
+
+#include "harness.hpp"
+
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <cppjobs/future.hpp>
+#include <cppjobs/mutex.hpp>
+#include <cppjobs/shared_mutex.hpp>
+#include <cppjobs/schedulers/thread_pool_scheduler.hpp>
+
+using bench::clock_type;
+
+
+static double elapsed_ns(clock_type::time_point start) {
+	return std::chrono::duration<double, std::nano>(clock_type::now() - start).count();
+}
+
+
+static std::shared_ptr<cppjobs::thread_pool_scheduler> make_pool(size_t num_threads) {
+	cppjobs::thread_pool_options options;
+	options.num_threads = num_threads;
+	options.pinning = cppjobs::thread_pinning::none;
+	return std::make_shared<cppjobs::thread_pool_scheduler>(options);
+}
+
+
+/// <summary>
+/// Runs the rounds and adds a throughput and a latency row to the report.
+/// The round fills in the latencies of its operations and returns how long it took.
+/// </summary>
+template <class Round>
+static void run(const bench::options& options, bench::report& report, const std::string& name, size_t threads, size_t ops, Round round) {
+	std::vector<double> latencies;
+	const auto throughput = bench::measure(options.rounds, ops, [&] { return round(latencies); });
+	report.add({ name, threads, ops, throughput });
+	const size_t num_latencies = latencies.size();
+	report.add({ name + "/latency", threads, num_latencies, bench::stats::of(std::move(latencies)) });
+}
+
+
+//------------------------------------------------------------------------------
+// Fan-out, fan-in
+//------------------------------------------------------------------------------
+
+static cppjobs::future<size_t> cppjobs_tree(cppjobs::thread_pool_scheduler* sched, size_t depth) {
+	if (depth == 0) {
+		co_return 1;
+	}
+	auto right = sched->schedule(&cppjobs_tree, sched, depth - 1);
+	right.start();
+	const size_t left = co_await cppjobs_tree(sched, depth - 1);
+	co_return 1 + left + co_await right;
+}
+
+static size_t std_tree(size_t depth) {
+	if (depth == 0) {
+		return 1;
+	}
+	auto right = std::async(std::launch::async, &std_tree, depth - 1);
+	const size_t left = std_tree(depth - 1);
+	return 1 + left + right.get();
+}
+
+static void fan_out(const bench::options& options, bench::report& report) {
+	constexpr size_t depth = 10;
+	constexpr size_t ops = (size_t(2) << depth) - 1;
+
+	if (options.selected("fan_out/cppjobs")) {
+		for (size_t threads : options.thread_counts()) {
+			auto sched = make_pool(threads);
+			run(options, report, "fan_out/cppjobs", threads, ops, [&](std::vector<double>& latencies) {
+				const auto start = clock_type::now();
+				sched->schedule(&cppjobs_tree, sched.get(), depth).get();
+				latencies.push_back(elapsed_ns(start));
+				return clock_type::now() - start;
+			});
+		}
+	}
+	if (options.selected("fan_out/std::async")) {
+		run(options, report, "fan_out/std::async", 0, ops, [&](std::vector<double>& latencies) {
+			const auto start = clock_type::now();
+			std_tree(depth);
+			latencies.push_back(elapsed_ns(start));
+			return clock_type::now() - start;
+		});
+	}
+}
+
+
+//------------------------------------------------------------------------------
+// Ping-pong
+//------------------------------------------------------------------------------
+
+static void ping_pong(const bench::options& options, bench::report& report) {
+	constexpr size_t ops = 10'000;
+
+	if (options.selected("ping_pong/cppjobs")) {
+		// The pool runs the answer on whichever worker is free, often the one that asked.
+		auto ping = [](cppjobs::thread_pool_scheduler* sched, size_t count, std::vector<double>* latencies) -> cppjobs::future<void> {
+			auto pong = [](size_t value) { return value + 1; };
+			for (size_t i = 0; i < count; ++i) {
+				const auto start = clock_type::now();
+				co_await sched->schedule(pong, i);
+				latencies->push_back(elapsed_ns(start));
+			}
+		};
+		auto sched = make_pool(2);
+		run(options, report, "ping_pong/cppjobs", 2, ops, [&](std::vector<double>& latencies) {
+			return bench::timed([&] { sched->schedule(ping, sched.get(), ops, &latencies).get(); });
+		});
+	}
+	if (options.selected("ping_pong/std::async")) {
+		constexpr size_t async_ops = ops / 5; // A new thread for each request.
+		run(options, report, "ping_pong/std::async", 0, async_ops, [&](std::vector<double>& latencies) {
+			return bench::timed([&] {
+				for (size_t i = 0; i < async_ops; ++i) {
+					const auto start = clock_type::now();
+					std::async(std::launch::async, [i] { return i + 1; }).get();
+					latencies.push_back(elapsed_ns(start));
+				}
+			});
+		});
+	}
+	if (options.selected("ping_pong/std::thread")) {
+		run(options, report, "ping_pong/std::thread", 2, ops, [&](std::vector<double>& latencies) {
+			std::mutex mtx;
+			std::condition_variable cv;
+			size_t turn = 0; // Odd when the request is out.
+			return bench::timed([&] {
+				std::thread ponger([&] {
+					for (size_t i = 0; i < ops; ++i) {
+						std::unique_lock lk(mtx);
+						cv.wait(lk, [&] { return turn % 2 == 1; });
+						++turn;
+						cv.notify_one();
+					}
+				});
+				for (size_t i = 0; i < ops; ++i) {
+					const auto start = clock_type::now();
+					std::unique_lock lk(mtx);
+					++turn;
+					cv.notify_one();
+					cv.wait(lk, [&] { return turn % 2 == 0; });
+					lk.unlock();
+					latencies.push_back(elapsed_ns(start));
+				}
+				ponger.join();
+			});
+		});
+	}
+}
+
+
+//------------------------------------------------------------------------------
+// Contended counter
+//------------------------------------------------------------------------------
+
+static void counter(const bench::options& options, bench::report& report) {
+	constexpr size_t ops = 200'000;
+
+	if (options.selected("counter/cppjobs")) {
+		auto increment = [](cppjobs::mutex* mtx, size_t* counter, size_t count, std::vector<double>* latencies) -> cppjobs::future<void> {
+			for (size_t i = 0; i < count; ++i) {
+				const auto start = clock_type::now();
+				cppjobs::lock_guard<cppjobs::mutex> lk{ co_await *mtx };
+				latencies->push_back(elapsed_ns(start));
+				++*counter;
+			}
+		};
+		for (size_t threads : options.thread_counts()) {
+			auto sched = make_pool(threads);
+			run(options, report, "counter/cppjobs", threads, ops, [&](std::vector<double>& latencies) {
+				cppjobs::mutex mtx;
+				size_t value = 0;
+				std::vector<std::vector<double>> per_task(threads);
+				const auto elapsed = bench::timed([&] {
+					std::vector<cppjobs::future<void>> tasks;
+					for (size_t i = 0; i < threads; ++i) {
+						tasks.push_back(sched->schedule(increment, &mtx, &value, ops / threads, &per_task[i]));
+						tasks.back().start();
+					}
+					for (auto& task : tasks) {
+						task.get();
+					}
+				});
+				for (auto& samples : per_task) {
+					latencies.insert(latencies.end(), samples.begin(), samples.end());
+				}
+				return elapsed;
+			});
+		}
+	}
+	if (options.selected("counter/std")) {
+		for (size_t threads : options.thread_counts()) {
+			run(options, report, "counter/std", threads, ops, [&](std::vector<double>& latencies) {
+				std::mutex mtx;
+				size_t value = 0;
+				std::vector<std::vector<double>> per_thread(threads);
+				const auto elapsed = bench::timed([&] {
+					std::vector<std::thread> workers;
+					for (size_t i = 0; i < threads; ++i) {
+						workers.emplace_back([&, samples = &per_thread[i]] {
+							for (size_t j = 0; j < ops / threads; ++j) {
+								const auto start = clock_type::now();
+								std::lock_guard lk(mtx);
+								samples->push_back(elapsed_ns(start));
+								++value;
+							}
+						});
+					}
+					for (auto& worker : workers) {
+						worker.join();
+					}
+				});
+				for (auto& samples : per_thread) {
+					latencies.insert(latencies.end(), samples.begin(), samples.end());
+				}
+				return elapsed;
+			});
+		}
+	}
+}
+
+
+//------------------------------------------------------------------------------
+// Reader-heavy map
+//------------------------------------------------------------------------------
+
+constexpr size_t map_size = 1024;
+constexpr size_t write_every = 20;
+
+static size_t key_of(size_t task, size_t op) {
+	return (task * 7919 + op * 104729) % map_size;
+}
+
+static void read_map(const bench::options& options, bench::report& report) {
+	constexpr size_t ops = 200'000;
+	std::unordered_map<size_t, size_t> initial;
+	for (size_t key = 0; key < map_size; ++key) {
+		initial[key] = key;
+	}
+
+	if (options.selected("read_map/cppjobs")) {
+		auto access = [](cppjobs::shared_mutex* mtx, std::unordered_map<size_t, size_t>* map, size_t task, size_t count, std::vector<double>* latencies) -> cppjobs::future<size_t> {
+			size_t sum = 0;
+			for (size_t i = 0; i < count; ++i) {
+				const size_t key = key_of(task, i);
+				const auto start = clock_type::now();
+				if (i % write_every == 0) {
+					co_await unique(*mtx);
+					latencies->push_back(elapsed_ns(start));
+					++(*map)[key];
+					mtx->unlock();
+				}
+				else {
+					co_await shared(*mtx);
+					latencies->push_back(elapsed_ns(start));
+					sum += map->find(key)->second;
+					mtx->unlock_shared();
+				}
+			}
+			co_return sum;
+		};
+		for (size_t threads : options.thread_counts()) {
+			auto sched = make_pool(threads);
+			run(options, report, "read_map/cppjobs", threads, ops, [&](std::vector<double>& latencies) {
+				cppjobs::shared_mutex mtx;
+				auto map = initial;
+				std::vector<std::vector<double>> per_task(threads);
+				const auto elapsed = bench::timed([&] {
+					std::vector<cppjobs::future<size_t>> tasks;
+					for (size_t i = 0; i < threads; ++i) {
+						tasks.push_back(sched->schedule(access, &mtx, &map, i, ops / threads, &per_task[i]));
+						tasks.back().start();
+					}
+					for (auto& task : tasks) {
+						task.get();
+					}
+				});
+				for (auto& samples : per_task) {
+					latencies.insert(latencies.end(), samples.begin(), samples.end());
+				}
+				return elapsed;
+			});
+		}
+	}
+	if (options.selected("read_map/std")) {
+		for (size_t threads : options.thread_counts()) {
+			run(options, report, "read_map/std", threads, ops, [&](std::vector<double>& latencies) {
+				std::shared_mutex mtx;
+				auto map = initial;
+				std::vector<std::vector<double>> per_thread(threads);
+				const auto elapsed = bench::timed([&] {
+					std::vector<std::thread> workers;
+					for (size_t i = 0; i < threads; ++i) {
+						workers.emplace_back([&, task = i, samples = &per_thread[i]] {
+							volatile size_t sum = 0;
+							for (size_t j = 0; j < ops / threads; ++j) {
+								const size_t key = key_of(task, j);
+								const auto start = clock_type::now();
+								if (j % write_every == 0) {
+									std::unique_lock lk(mtx);
+									samples->push_back(elapsed_ns(start));
+									++map[key];
+								}
+								else {
+									std::shared_lock lk(mtx);
+									samples->push_back(elapsed_ns(start));
+									sum = sum + map.find(key)->second;
+								}
+							}
+						});
+					}
+					for (auto& worker : workers) {
+						worker.join();
+					}
+				});
+				for (auto& samples : per_thread) {
+					latencies.insert(latencies.end(), samples.begin(), samples.end());
+				}
+				return elapsed;
+			});
+		}
+	}
+}
+
+
+int main(int argc, char* argv[]) {
+	const auto options = bench::options::parse(argc, argv);
+	bench::report report(options);
+	fan_out(options, report);
+	ping_pong(options, report);
+	counter(options, report);
+	read_map(options, report);
+	report.finish();
+	return 0;
+}
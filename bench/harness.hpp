@@ -0,0 +1,349 @@
+// Helpers shared by the benchmark programs: command line options, timing, summary statistics,
+// and output as a table for people or as JSON for tracking regressions between releases.
+//
+// Common options:
+//   --json           Print JSON instead of a table.
+//   --filter=TEXT    Only run benchmarks whose name contains TEXT.
+//   --threads=N      Largest thread count for the benchmarks that scale over threads.
+//   --rounds=N       Number of times each benchmark is repeated.
+//   --no-counters    Don't read the hardware and software performance counters.
+//
+// On Linux, the timed parts of the benchmarks are also measured with perf_event_open: cycles, instructions,
+// cache misses, branch misses and context switches per operation, of all threads of the process.
+// Counters the system doesn't provide, e.g. hardware counters in most virtual machines, are left empty.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+namespace bench {
+
+using clock_type = std::chrono::steady_clock;
+
+
+constexpr size_t num_counters = 5;
+constexpr std::array<const char*, num_counters> counter_names = { "cycles", "instructions", "cache_misses", "branch_misses", "context_switches" };
+/// <summary> Counts per operation, NaN for counters that weren't measured. </summary>
+using counter_values = std::array<double, num_counters>;
+
+inline counter_values no_counters() {
+	counter_values values;
+	values.fill(std::nan(""));
+	return values;
+}
+
+
+/// <summary>
+/// Performance counters of the whole process. They are opened in options::parse, before the benchmarks start
+/// any threads, and the threads started later inherit them. timed adds up what its function spent,
+/// measure turns the sum of its rounds into counts per operation, and report::add attaches those to the result.
+/// </summary>
+/// <remarks>
+/// Counting kernel time needs perf_event_paranoid below 2 or CAP_PERFMON, otherwise only user space is counted,
+/// and the cycles and instructions of syscalls are missing. The kernel multiplexes the counters if there are
+/// more than the CPU has, the counts are scaled up by the time each one ran.
+/// </remarks>
+class perf_counters {
+public:
+	using raw_values = std::array<double, num_counters>;
+
+	static perf_counters& instance() {
+		static perf_counters counters;
+		return counters;
+	}
+
+	void open() {
+#ifdef __linux__
+		constexpr std::array<std::pair<uint32_t, uint64_t>, num_counters> events = { {
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+			{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+			{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+		} };
+		for (size_t index = 0; index < num_counters; ++index) {
+			if (m_fds[index] < 0) {
+				m_fds[index] = open_event(events[index].first, events[index].second, true);
+			}
+			if (m_fds[index] < 0) {
+				m_fds[index] = open_event(events[index].first, events[index].second, false);
+			}
+		}
+#endif
+	}
+
+	/// <summary> The current counts, NaN for the counters that couldn't be opened. </summary>
+	raw_values read() const {
+		raw_values values;
+		for (size_t index = 0; index < num_counters; ++index) {
+			values[index] = std::nan("");
+#ifdef __linux__
+			// The value, the time the counter was enabled, and the time it was actually counting.
+			uint64_t data[3] = {};
+			if (m_fds[index] >= 0 && ::read(m_fds[index], data, sizeof(data)) == sizeof(data)) {
+				values[index] = data[2] > 0 ? double(data[0]) * double(data[1]) / double(data[2]) : 0.0;
+			}
+#endif
+		}
+		return values;
+	}
+
+	void add(const raw_values& begin, const raw_values& end) {
+		for (size_t index = 0; index < num_counters; ++index) {
+			m_sum[index] += end[index] - begin[index];
+		}
+	}
+
+	/// <summary> Starts a new sum for measure. </summary>
+	void clear() {
+		m_sum.fill(0);
+	}
+
+	/// <summary> Makes the sum so far the counts of the next result, divided by the number of operations. </summary>
+	void finish(size_t ops) {
+		for (size_t index = 0; index < num_counters; ++index) {
+			m_measured[index] = ops > 0 ? m_sum[index] / double(ops) : std::nan("");
+		}
+	}
+
+	/// <summary> The counts of the last measure, once, as a result that wasn't measured has none. </summary>
+	counter_values take() {
+		return std::exchange(m_measured, no_counters());
+	}
+
+private:
+	perf_counters() {
+		m_fds.fill(-1);
+	}
+
+#ifdef __linux__
+	static int open_event(uint32_t type, uint64_t config, bool count_kernel) {
+		perf_event_attr attr = {};
+		attr.size = sizeof(attr);
+		attr.type = type;
+		attr.config = config;
+		attr.inherit = 1;
+		attr.exclude_kernel = count_kernel ? 0 : 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+		return int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+	}
+#endif
+
+private:
+	std::array<int, num_counters> m_fds;
+	raw_values m_sum = {};
+	counter_values m_measured = no_counters();
+};
+
+
+struct options {
+	bool json = false;
+	std::string filter;
+	size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+	size_t rounds = 5;
+	bool counters = true;
+
+	/// <summary> Options the harness doesn't know go to extra, which returns false if it doesn't know them either. </summary>
+	static options parse(int argc, char* argv[], const std::function<bool(std::string_view)>& extra = nullptr) {
+		options result;
+		for (int i = 1; i < argc; ++i) {
+			const std::string_view arg = argv[i];
+			if (arg == "--json") {
+				result.json = true;
+			}
+			else if (arg.starts_with("--filter=")) {
+				result.filter = arg.substr(9);
+			}
+			else if (arg.starts_with("--threads=")) {
+				result.max_threads = std::max<size_t>(1, std::strtoul(argv[i] + 10, nullptr, 10));
+			}
+			else if (arg.starts_with("--rounds=")) {
+				result.rounds = std::max<size_t>(1, std::strtoul(argv[i] + 9, nullptr, 10));
+			}
+			else if (arg == "--no-counters") {
+				result.counters = false;
+			}
+			else if (!extra || !extra(arg)) {
+				std::fprintf(stderr, "unknown option: %s\n", argv[i]);
+				std::exit(2);
+			}
+		}
+		if (result.counters) {
+			perf_counters::instance().open();
+		}
+		return result;
+	}
+
+	bool selected(std::string_view name) const {
+		return name.find(filter) != std::string_view::npos;
+	}
+
+	/// <summary> Powers of two up to max_threads, and max_threads itself. </summary>
+	std::vector<size_t> thread_counts() const {
+		std::vector<size_t> counts;
+		for (size_t count = 1; count < max_threads; count *= 2) {
+			counts.push_back(count);
+		}
+		counts.push_back(max_threads);
+		return counts;
+	}
+};
+
+
+/// <summary> Summary of a set of samples, in nanoseconds. </summary>
+struct stats {
+	double min = 0;
+	double median = 0;
+	double p90 = 0;
+	double p99 = 0;
+	double max = 0;
+
+	static stats of(std::vector<double> samples) {
+		if (samples.empty()) {
+			return {};
+		}
+		std::ranges::sort(samples);
+		const auto at = [&samples](double quantile) {
+			return samples[std::min(samples.size() - 1, size_t(quantile * double(samples.size())))];
+		};
+		return { samples.front(), at(0.5), at(0.9), at(0.99), samples.back() };
+	}
+};
+
+
+struct result {
+	std::string name;
+	size_t threads = 1;
+	/// <summary> Number of operations the samples were taken over. </summary>
+	size_t ops = 0;
+	/// <summary> Time per operation: an average per round for throughput, or one sample per operation for latency. </summary>
+	stats ns_per_op;
+	/// <summary> Filled in by report::add if the result comes from measure. </summary>
+	counter_values counters_per_op = no_counters();
+};
+
+
+/// <summary>
+/// Runs a round rounds times, and returns the time per op of each.
+/// The round returns how long its timed part took, so that it can leave its setup out.
+/// The performance counters are averaged over all rounds.
+/// </summary>
+template <class Round>
+stats measure(size_t rounds, size_t ops, Round round) {
+	std::vector<double> samples;
+	perf_counters::instance().clear();
+	for (size_t i = 0; i < rounds; ++i) {
+		const clock_type::duration elapsed = round();
+		samples.push_back(std::chrono::duration<double, std::nano>(elapsed).count() / double(ops));
+	}
+	perf_counters::instance().finish(rounds * ops);
+	return stats::of(std::move(samples));
+}
+
+
+/// <summary> Times func from start to end, and adds the performance counters of the same span to measure's sum. </summary>
+template <class Func>
+clock_type::duration timed(Func func) {
+	auto& counters = perf_counters::instance();
+	const auto begin = counters.read();
+	const auto start = clock_type::now();
+	func();
+	const auto elapsed = clock_type::now() - start;
+	counters.add(begin, counters.read());
+	return elapsed;
+}
+
+
+class report {
+public:
+	explicit report(const options& options) : m_json(options.json) {}
+
+	void add(result item) {
+		if (std::ranges::all_of(item.counters_per_op, [](double value) { return std::isnan(value); })) {
+			item.counters_per_op = perf_counters::instance().take();
+		}
+		if (!m_json) {
+			print_row(item);
+		}
+		m_results.push_back(std::move(item));
+	}
+
+	/// <summary> Prints the JSON document. Table rows are printed as results come in. </summary>
+	void finish() const {
+		if (!m_json) {
+			return;
+		}
+		std::printf("{\n\t\"benchmarks\": [");
+		for (size_t i = 0; i < m_results.size(); ++i) {
+			const result& item = m_results[i];
+			const stats& ns = item.ns_per_op;
+			std::printf("%s\n\t\t{ \"name\": \"%s\", \"threads\": %zu, \"ops\": %zu, "
+						"\"ns_per_op\": { \"min\": %.2f, \"median\": %.2f, \"p90\": %.2f, \"p99\": %.2f, \"max\": %.2f }",
+						i == 0 ? "" : ",", item.name.c_str(), item.threads, item.ops, ns.min, ns.median, ns.p90, ns.p99, ns.max);
+			std::printf(", \"counters_per_op\": {");
+			for (size_t index = 0; index < num_counters; ++index) {
+				const double value = item.counters_per_op[index];
+				// JSON has no NaN, counters that weren't measured are null.
+				if (std::isnan(value)) {
+					std::printf("%s \"%s\": null", index == 0 ? "" : ",", counter_names[index]);
+				}
+				else {
+					std::printf("%s \"%s\": %.4f", index == 0 ? "" : ",", counter_names[index], value);
+				}
+			}
+			std::printf(" } }");
+		}
+		std::printf("\n\t]\n}\n");
+	}
+
+private:
+	void print_row(const result& item) {
+		if (!m_header_printed) {
+			std::printf("%-34s %8s %10s %12s %12s %12s %14s %10s %10s %10s %10s %10s\n", "benchmark", "threads", "ops", "min [ns]", "median [ns]",
+						"p99 [ns]", "ops/s (median)", "cycles", "instr", "cache-mis", "branch-mis", "ctx-sw");
+			m_header_printed = true;
+		}
+		const stats& ns = item.ns_per_op;
+		std::printf("%-34s %8zu %10zu %12.1f %12.1f %12.1f %14.0f",
+					item.name.c_str(), item.threads, item.ops, ns.min, ns.median, ns.p99, ns.median > 0 ? 1e9 / ns.median : 0.0);
+		// Context switches per operation are usually well below one.
+		for (size_t index = 0; index < num_counters; ++index) {
+			const double value = item.counters_per_op[index];
+			if (std::isnan(value)) {
+				std::printf(" %10s", "-");
+			}
+			else {
+				std::printf(index + 1 < num_counters ? " %10.1f" : " %10.4f", value);
+			}
+		}
+		std::printf("\n");
+		std::fflush(stdout);
+	}
+
+private:
+	bool m_json;
+	bool m_header_printed = false;
+	std::vector<result> m_results;
+};
+
+
+} // namespace bench
@@ -0,0 +1,77 @@
+// Wake-up latency versus idle CPU burn of the thread pool's idle policies.
+//
+// A task is submitted from an outside thread after a pause, so the workers have time
+// to go idle. The latency is the time from queueing the task to the task starting.
+// CPU use is the process CPU time over wall time, in cores, mostly spent by idle workers.
+//
+// Usage: bench_idle_policy [samples] [gap in microseconds] [threads]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <thread>
+#include <vector>
+#include <cppjobs/schedulers/thread_pool_scheduler.hpp>
+
+using namespace cppjobs;
+using clock_type = std::chrono::steady_clock;
+
+
+struct measurement {
+	double p50_us;
+	double p99_us;
+	double cpu_cores;
+};
+
+
+measurement measure(idle_policy idle, size_t num_threads, size_t samples, std::chrono::microseconds gap) {
+	auto sched = std::make_shared<thread_pool_scheduler>(thread_pool_options{ .num_threads = num_threads, .idle = idle });
+	std::vector<double> latencies;
+	latencies.reserve(samples);
+
+	const auto cpu_start = std::clock();
+	const auto wall_start = clock_type::now();
+	for (size_t i = 0; i < samples; ++i) {
+		std::this_thread::sleep_for(gap);
+		auto fut = sched->schedule([] { return clock_type::now(); });
+		const auto queued = clock_type::now();
+		const auto started = fut.get();
+		latencies.push_back(std::chrono::duration<double, std::micro>(started - queued).count());
+	}
+	const double cpu_seconds = double(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+	const double wall_seconds = std::chrono::duration<double>(clock_type::now() - wall_start).count();
+
+	std::ranges::sort(latencies);
+	return {
+		.p50_us = latencies[latencies.size() / 2],
+		.p99_us = latencies[latencies.size() * 99 / 100],
+		.cpu_cores = cpu_seconds / wall_seconds,
+	};
+}
+
+
+int main(int argc, char* argv[]) {
+	const size_t samples = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000;
+	const auto gap = std::chrono::microseconds(argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 500);
+	const size_t num_threads = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : std::max(1u, std::thread::hardware_concurrency());
+
+	struct {
+		const char* name;
+		idle_policy idle;
+	} policies[] = {
+		{ "low_power", idle_policy::low_power() },
+		{ "default", idle_policy{} },
+		{ "low_latency", idle_policy::low_latency() },
+		{ "spin_only", idle_policy{ .spin = std::chrono::seconds(1), .yield = {} } },
+	};
+
+	std::printf("%zu samples, %lld us gap, %zu workers\n", samples, (long long)gap.count(), num_threads);
+	std::printf("%-12s %12s %12s %12s\n", "policy", "p50 [us]", "p99 [us]", "CPU [cores]");
+	for (const auto& [name, idle] : policies) {
+		const auto result = measure(idle, num_threads, samples, gap);
+		std::printf("%-12s %12.2f %12.2f %12.2f\n", name, result.p50_us, result.p99_us, result.cpu_cores);
+	}
+	return 0;
+}
@@ -0,0 +1,62 @@
+// Cost of submitting tasks to the thread pool from a thread outside the pool.
+//
+// Only the submitting thread is timed, from the first task created to the last one queued.
+// Workers run the tasks meanwhile, and everything is waited for before the next round.
+//
+// Usage: bench_injection [tasks per round] [rounds]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <vector>
+#include <cppjobs/schedulers/thread_pool_scheduler.hpp>
+
+using namespace cppjobs;
+using clock_type = std::chrono::steady_clock;
+
+
+template <class Submit>
+double best_ns_per_task(size_t tasks, size_t rounds, Submit submit) {
+	double best = std::numeric_limits<double>::max();
+	for (size_t round = 0; round < rounds; ++round) {
+		const auto start = clock_type::now();
+		auto futures = submit();
+		const auto end = clock_type::now();
+		for (auto& fut : futures) {
+			fut.wait();
+		}
+		best = std::min(best, std::chrono::duration<double, std::nano>(end - start).count() / double(tasks));
+	}
+	return best;
+}
+
+
+int main(int argc, char* argv[]) {
+	const size_t tasks = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+	const size_t rounds = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 10;
+
+	auto sched = std::make_shared<thread_pool_scheduler>();
+	std::vector<std::function<int()>> funcs(tasks, [] { return 0; });
+
+	const double one_by_one = best_ns_per_task(tasks, rounds, [&] {
+		std::vector<future<int>> futures;
+		futures.reserve(tasks);
+		for (auto& func : funcs) {
+			futures.push_back(sched->schedule(func));
+			futures.back().start();
+		}
+		return futures;
+	});
+	const double batched = best_ns_per_task(tasks, rounds, [&] {
+		return sched->schedule_batch(funcs);
+	});
+
+	std::printf("%zu tasks, %zu workers\n", tasks, sched->num_workers());
+	std::printf("%-12s %12s\n", "submission", "ns per task");
+	std::printf("%-12s %12.1f\n", "one_by_one", one_by_one);
+	std::printf("%-12s %12.1f\n", "batched", batched);
+	return 0;
+}
@@ -0,0 +1,296 @@
+// Microbenchmarks of the library's building blocks: futures, mutexes and schedulers.
+//
+// Throughput benchmarks report the average time per operation of each round, latency benchmarks
+// report one sample per operation. Run with --json to get a document to compare between releases.
+//
+// Usage: bench [--json] [--filter=TEXT] [--threads=N] [--rounds=N] [--no-counters]
+
+#include "harness.hpp"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <cppjobs/future.hpp>
+#include <cppjobs/mutex.hpp>
+#include <cppjobs/shared_mutex.hpp>
+#include <cppjobs/trace.hpp>
+#include <cppjobs/schedulers/immediate_scheduler.hpp>
+#include <cppjobs/schedulers/queue_scheduler.hpp>
+#include <cppjobs/schedulers/strand.hpp>
+#include <cppjobs/schedulers/thread_pool_scheduler.hpp>
+
+using namespace cppjobs;
+using bench::clock_type;
+
+
+/// <summary> Suspends the awaiting coroutine until it's resumed by hand. </summary>
+struct gate {
+	bool await_ready() const noexcept { return false; }
+	void await_suspend(std::coroutine_handle<> handle) noexcept { m_handle = handle; }
+	void await_resume() const noexcept {}
+	std::coroutine_handle<> m_handle;
+};
+
+
+static thread_pool_options pool_options(size_t num_threads) {
+	thread_pool_options options;
+	options.num_threads = num_threads;
+	options.pinning = thread_pinning::none;
+	return options;
+}
+
+
+static void future_benchmarks(const bench::options& options, bench::report& report) {
+	constexpr size_t ops = 100'000;
+	auto value = [](int value) -> future<int> { co_return value; };
+
+	if (options.selected("future/create_destroy")) {
+		report.add({ "future/create_destroy", 1, ops, bench::measure(options.rounds, ops, [&] {
+						 return bench::timed([&] {
+							 for (size_t i = 0; i < ops; ++i) {
+								 auto fut = value(int(i));
+							 }
+						 });
+					 }) });
+	}
+	if (options.selected("future/create_get")) {
+		report.add({ "future/create_get", 1, ops, bench::measure(options.rounds, ops, [&] {
+						 volatile int sink = 0;
+						 return bench::timed([&] {
+							 for (size_t i = 0; i < ops; ++i) {
+								 sink = value(int(i)).get();
+							 }
+						 });
+					 }) });
+	}
+	if (options.selected("future/await_ready")) {
+		auto awaiter = [](std::vector<future<int>>* futures) -> future<int> {
+			int sum = 0;
+			for (auto& fut : *futures) {
+				sum += co_await fut;
+			}
+			co_return sum;
+		};
+		report.add({ "future/await_ready", 1, ops, bench::measure(options.rounds, ops, [&] {
+						 std::vector<future<int>> futures;
+						 for (size_t i = 0; i < ops; ++i) {
+							 futures.push_back(value(int(i)));
+							 futures.back().start(); // No scheduler, finishes right away.
+						 }
+						 return bench::timed([&] { awaiter(&futures).get(); });
+					 }) });
+	}
+	if (options.selected("future/await_pending")) {
+		// The awaiting coroutine suspends on each future, and is resumed inline when it finishes.
+		auto pending = [](gate* release) -> future<int> {
+			co_await *release;
+			co_return 1;
+		};
+		auto awaiter = [](std::vector<future<int>>* futures) -> future<int> {
+			int sum = 0;
+			for (auto& fut : *futures) {
+				sum += co_await fut;
+			}
+			co_return sum;
+		};
+		report.add({ "future/await_pending", 1, ops, bench::measure(options.rounds, ops, [&] {
+						 std::vector<gate> gates(ops);
+						 std::vector<future<int>> futures;
+						 for (auto& release : gates) {
+							 futures.push_back(pending(&release));
+							 futures.back().start();
+						 }
+						 auto sum = awaiter(&futures);
+						 sum.start();
+						 const auto elapsed = bench::timed([&] {
+							 for (auto& release : gates) {
+								 release.m_handle.resume();
+							 }
+						 });
+						 sum.get();
+						 return elapsed;
+					 }) });
+	}
+	if (options.selected("future/get_latency")) {
+		// From the moment a worker finishes the coroutine to get returning on the blocked thread.
+		constexpr size_t samples = 1000;
+		auto sched = std::make_shared<thread_pool_scheduler>(pool_options(1));
+		auto delayed = [](std::chrono::microseconds delay) -> future<clock_type::time_point> {
+			const auto until = clock_type::now() + delay;
+			while (clock_type::now() < until) {
+			}
+			co_return clock_type::now();
+		};
+		std::vector<double> latencies;
+		for (size_t i = 0; i < samples; ++i) {
+			auto fut = sched->schedule(delayed, std::chrono::microseconds(50));
+			fut.start();
+			const auto finished = fut.get();
+			latencies.push_back(std::chrono::duration<double, std::nano>(clock_type::now() - finished).count());
+		}
+		report.add({ "future/get_latency", 1, samples, bench::stats::of(std::move(latencies)) });
+	}
+}
+
+
+static void mutex_benchmarks(const bench::options& options, bench::report& report) {
+	constexpr size_t ops = 200'000;
+	auto increment = [](mutex* mtx, size_t* counter, size_t count) -> future<void> {
+		for (size_t i = 0; i < count; ++i) {
+			lock_guard<mutex> lk{ co_await *mtx };
+			++*counter;
+		}
+	};
+
+	if (options.selected("mutex/uncontended")) {
+		report.add({ "mutex/uncontended", 1, ops, bench::measure(options.rounds, ops, [&] {
+						 mutex mtx;
+						 size_t counter = 0;
+						 return bench::timed([&] { increment(&mtx, &counter, ops).get(); });
+					 }) });
+	}
+	if (options.selected("mutex/contended")) {
+		for (size_t threads : options.thread_counts()) {
+			auto sched = std::make_shared<thread_pool_scheduler>(pool_options(threads));
+			report.add({ "mutex/contended", threads, ops, bench::measure(options.rounds, ops, [&] {
+							 mutex mtx;
+							 size_t counter = 0;
+							 return bench::timed([&] {
+								 std::vector<future<void>> tasks;
+								 for (size_t i = 0; i < threads; ++i) {
+									 tasks.push_back(sched->schedule(increment, &mtx, &counter, ops / threads));
+									 tasks.back().start();
+								 }
+								 for (auto& task : tasks) {
+									 task.get();
+								 }
+							 });
+						 }) });
+		}
+	}
+	if (options.selected("shared_mutex/read")) {
+		auto read = [](shared_mutex* mtx, const size_t* value, size_t count) -> future<size_t> {
+			size_t sum = 0;
+			for (size_t i = 0; i < count; ++i) {
+				co_await shared(*mtx);
+				sum += *value;
+				mtx->unlock_shared();
+			}
+			co_return sum;
+		};
+		for (size_t threads : options.thread_counts()) {
+			auto sched = std::make_shared<thread_pool_scheduler>(pool_options(threads));
+			report.add({ "shared_mutex/read", threads, ops, bench::measure(options.rounds, ops, [&] {
+							 shared_mutex mtx;
+							 const size_t value = 1;
+							 return bench::timed([&] {
+								 std::vector<future<size_t>> tasks;
+								 for (size_t i = 0; i < threads; ++i) {
+									 tasks.push_back(sched->schedule(read, &mtx, &value, ops / threads));
+									 tasks.back().start();
+								 }
+								 for (auto& task : tasks) {
+									 task.get();
+								 }
+							 });
+						 }) });
+		}
+	}
+}
+
+
+template <class Scheduler>
+static bench::stats schedule_round_trips(const bench::options& options, Scheduler& sched, size_t ops) {
+	return bench::measure(options.rounds, ops, [&] {
+		volatile int sink = 0;
+		return bench::timed([&] {
+			for (size_t i = 0; i < ops; ++i) {
+				sink = sched.schedule([] { return 1; }).get();
+			}
+		});
+	});
+}
+
+
+template <class Scheduler>
+static bench::stats schedule_throughput(const bench::options& options, Scheduler& sched, size_t ops) {
+	return bench::measure(options.rounds, ops, [&] {
+		return bench::timed([&] {
+			std::vector<future<int>> futures;
+			futures.reserve(ops);
+			for (size_t i = 0; i < ops; ++i) {
+				futures.push_back(sched.schedule([] { return 1; }));
+				futures.back().start();
+			}
+			for (auto& fut : futures) {
+				fut.wait();
+			}
+		});
+	});
+}
+
+
+static void scheduler_benchmarks(const bench::options& options, bench::report& report) {
+	constexpr size_t ops = 100'000;
+
+	if (options.selected("schedule/immediate")) {
+		auto sched = std::make_shared<immediate_scheduler>();
+		report.add({ "schedule/immediate", 1, ops, schedule_round_trips(options, *sched, ops) });
+	}
+	if (options.selected("schedule/queue")) {
+		auto sched = std::make_shared<queue_scheduler>();
+		report.add({ "schedule/queue", 1, ops, schedule_round_trips(options, *sched, ops) });
+	}
+	if (options.selected("schedule/thread_pool_round_trip")) {
+		auto sched = std::make_shared<thread_pool_scheduler>(pool_options(1));
+		report.add({ "schedule/thread_pool_round_trip", 1, ops / 10, schedule_round_trips(options, *sched, ops / 10) });
+	}
+	if (options.selected("schedule/thread_pool")) {
+		for (size_t threads : options.thread_counts()) {
+			auto sched = std::make_shared<thread_pool_scheduler>(pool_options(threads));
+			report.add({ "schedule/thread_pool", threads, ops, schedule_throughput(options, *sched, ops) });
+		}
+	}
+	if (options.selected("schedule/strand")) {
+		for (size_t threads : options.thread_counts()) {
+			auto pool = std::make_shared<thread_pool_scheduler>(pool_options(threads));
+			auto sched = std::make_shared<strand>(pool);
+			report.add({ "schedule/strand", threads, ops, schedule_throughput(options, *sched, ops) });
+		}
+	}
+}
+
+
+static void trace_benchmarks(const bench::options& options, bench::report& report) {
+	constexpr size_t ops = 1'000'000;
+
+	for (const bool enabled : { false, true }) {
+		const char* name = enabled ? "trace/record" : "trace/record_disabled";
+		if (!options.selected(name)) {
+			continue;
+		}
+		tracer::enable(enabled);
+		report.add({ name, 1, ops, bench::measure(options.rounds, ops, [&] {
+						 return bench::timed([&] {
+							 for (size_t i = 0; i < ops; ++i) {
+								 tracer::record(trace_event::resume, &i);
+							 }
+						 });
+					 }) });
+		tracer::enable(false);
+		tracer::clear();
+	}
+}
+
+
+int main(int argc, char* argv[]) {
+	const auto options = bench::options::parse(argc, argv);
+	bench::report report(options);
+	future_benchmarks(options, report);
+	mutex_benchmarks(options, report);
+	scheduler_benchmarks(options, report);
+	trace_benchmarks(options, report);
+	report.finish();
+	return 0;
+}
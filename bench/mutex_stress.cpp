@@ -0,0 +1,331 @@
+// Stress test of mutex and shared_mutex: throughput, fairness, starvation and wait times under load.
+//
+// Every thread of a pool runs one task, which locks the mutex in a loop until the round's time is up.
+// A task of the shared_mutex rows takes the shared lock with the probability of the read ratio, and the
+// exclusive lock otherwise. It holds the lock for the critical section's length, then works as long outside it.
+//
+// ops/s       Acquisitions per second, the median of the rounds.
+// jain        Jain's fairness index of the acquisitions per task: 1 if each got the same share, 1/n if one got all.
+// min, max    The smallest and the largest share of a task, relative to the fair share.
+// starved     Waits longer than --starvation-ms, and tasks that never got the lock in a round.
+// wait        Percentiles of the time from asking for the lock to getting it, of readers and writers.
+// bad         Times a writer was inside with anyone else, or a reader with a writer. Anything but 0
+//             is a bug in the mutex, and makes the program exit with 1.
+//
+// Usage: bench_mutex_stress [--json] [--filter=TEXT] [--threads=N] [--rounds=N] [--read-ratios=0,0.5,0.9,0.99]
+//                           [--hold-ns=0,1000] [--duration-ms=200] [--starvation-ms=10]
+
+#include "harness.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cppjobs/future.hpp>
+#include <cppjobs/latency_histogram.hpp>
+#include <cppjobs/mutex.hpp>
+#include <cppjobs/shared_mutex.hpp>
+#include <cppjobs/schedulers/thread_pool_scheduler.hpp>
+
+using namespace cppjobs;
+using bench::clock_type;
+
+
+struct stress_options {
+	std::vector<double> read_ratios = { 0.0, 0.5, 0.9, 0.99 };
+	std::vector<int64_t> hold_ns = { 0, 1000 };
+	std::chrono::milliseconds duration{ 200 };
+	std::chrono::milliseconds starvation{ 10 };
+
+	bool parse(std::string_view arg) {
+		if (arg.starts_with("--read-ratios=")) {
+			read_ratios.clear();
+			for_each_item(arg.substr(14), [this](const std::string& item) { read_ratios.push_back(std::strtod(item.c_str(), nullptr)); });
+		}
+		else if (arg.starts_with("--hold-ns=")) {
+			hold_ns.clear();
+			for_each_item(arg.substr(10), [this](const std::string& item) { hold_ns.push_back(std::strtoll(item.c_str(), nullptr, 10)); });
+		}
+		else if (arg.starts_with("--duration-ms=")) {
+			duration = std::chrono::milliseconds(std::strtoll(arg.substr(14).data(), nullptr, 10));
+		}
+		else if (arg.starts_with("--starvation-ms=")) {
+			starvation = std::chrono::milliseconds(std::strtoll(arg.substr(16).data(), nullptr, 10));
+		}
+		else {
+			return false;
+		}
+		return true;
+	}
+
+	template <class Func>
+	static void for_each_item(std::string_view list, Func func) {
+		while (!list.empty()) {
+			const size_t comma = std::min(list.find(','), list.size());
+			func(std::string(list.substr(0, comma)));
+			list.remove_prefix(std::min(comma + 1, list.size()));
+		}
+	}
+};
+
+
+/// <summary> What the tasks of a round share. </summary>
+struct round_state {
+	clock_type::time_point deadline;
+	double read_ratio = 0;
+	int64_t hold_ns = 0;
+	int64_t starvation_ns = 0;
+	std::atomic_int64_t readers_inside = 0;
+	std::atomic_int64_t writers_inside = 0;
+	std::atomic_uint64_t violations = 0;
+	latency_histogram read_wait;
+	latency_histogram write_wait;
+};
+
+
+struct alignas(64) task_stats {
+	uint64_t acquisitions = 0;
+	uint64_t starved_waits = 0;
+};
+
+
+struct outcome {
+	std::string name;
+	size_t threads = 0;
+	double read_ratio = 0;
+	int64_t hold_ns = 0;
+	uint64_t acquisitions = 0;
+	bench::stats ns_per_op;
+	double jain = 0;
+	double min_share = 0;
+	double max_share = 0;
+	uint64_t starved_waits = 0;
+	uint64_t starved_tasks = 0;
+	latency_distribution read_wait;
+	latency_distribution write_wait;
+	uint64_t violations = 0;
+};
+
+
+static void spin(int64_t ns) {
+	if (ns <= 0) {
+		return;
+	}
+	const int64_t until = latency_histogram::now() + ns;
+	while (latency_histogram::now() < until) {
+	}
+}
+
+
+static future<void> lock(mutex& mtx, bool) {
+	co_await mtx;
+}
+
+static void unlock(mutex& mtx, bool) {
+	mtx.unlock();
+}
+
+static future<void> lock(shared_mutex& mtx, bool read) {
+	if (read) {
+		co_await shared(mtx);
+	}
+	else {
+		co_await unique(mtx);
+	}
+}
+
+static void unlock(shared_mutex& mtx, bool read) {
+	read ? mtx.unlock_shared() : mtx.unlock();
+}
+
+
+template <class Mutex>
+static future<void> stress_task(Mutex* mtx, round_state* state, task_stats* stats, uint64_t seed) {
+	uint64_t random = seed * 0x9E3779B97F4A7C15ull + 1;
+	while (clock_type::now() < state->deadline) {
+		random ^= random << 13;
+		random ^= random >> 7;
+		random ^= random << 17;
+		const bool read = double(random >> 11) * 0x1.0p-53 < state->read_ratio;
+
+		const int64_t asked = latency_histogram::now();
+		co_await lock(*mtx, read);
+		const int64_t waited = latency_histogram::now() - asked;
+		(read ? state->read_wait : state->write_wait).record(waited);
+		stats->starved_waits += waited > state->starvation_ns;
+		++stats->acquisitions;
+
+		if (read) {
+			state->readers_inside.fetch_add(1);
+			state->violations += state->writers_inside.load() != 0;
+		}
+		else {
+			state->violations += state->writers_inside.fetch_add(1) != 0;
+			state->violations += state->readers_inside.load() != 0;
+		}
+		spin(state->hold_ns);
+		(read ? state->readers_inside : state->writers_inside).fetch_sub(1);
+		unlock(*mtx, read);
+
+		spin(state->hold_ns);
+	}
+}
+
+
+template <class Mutex>
+static outcome stress(const bench::options& options, const stress_options& stress_options, const std::string& name, size_t threads, double read_ratio, int64_t hold_ns) {
+	thread_pool_options pool_options;
+	pool_options.num_threads = threads;
+	pool_options.pinning = thread_pinning::none;
+	auto pool = std::make_shared<thread_pool_scheduler>(pool_options);
+
+	outcome result{ .name = name, .threads = threads, .read_ratio = read_ratio, .hold_ns = hold_ns };
+	std::vector<task_stats> totals(threads);
+	std::vector<double> samples;
+	for (size_t round = 0; round < options.rounds; ++round) {
+		Mutex mtx;
+		round_state state;
+		state.read_ratio = read_ratio;
+		state.hold_ns = hold_ns;
+		state.starvation_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(stress_options.starvation).count();
+		std::vector<task_stats> stats(threads);
+
+		const auto start = clock_type::now();
+		state.deadline = start + stress_options.duration;
+		std::vector<future<void>> tasks;
+		for (size_t i = 0; i < threads; ++i) {
+			tasks.push_back(pool->schedule(stress_task<Mutex>, &mtx, &state, &stats[i], uint64_t(round * threads + i)));
+			tasks.back().start();
+		}
+		for (auto& task : tasks) {
+			task.get();
+		}
+		const double elapsed = std::chrono::duration<double, std::nano>(clock_type::now() - start).count();
+
+		uint64_t acquisitions = 0;
+		for (size_t i = 0; i < threads; ++i) {
+			acquisitions += stats[i].acquisitions;
+			totals[i].acquisitions += stats[i].acquisitions;
+			totals[i].starved_waits += stats[i].starved_waits;
+			result.starved_tasks += stats[i].acquisitions == 0;
+		}
+		result.acquisitions += acquisitions;
+		samples.push_back(acquisitions > 0 ? elapsed / double(acquisitions) : elapsed);
+		result.read_wait += state.read_wait.snapshot();
+		result.write_wait += state.write_wait.snapshot();
+		result.violations += state.violations.load();
+	}
+	result.ns_per_op = bench::stats::of(std::move(samples));
+
+	double sum = 0;
+	double sum_squares = 0;
+	double min = INFINITY;
+	double max = 0;
+	for (const auto& item : totals) {
+		const double count = double(item.acquisitions);
+		sum += count;
+		sum_squares += count * count;
+		min = std::min(min, count);
+		max = std::max(max, count);
+		result.starved_waits += item.starved_waits;
+	}
+	const double fair_share = sum / double(threads);
+	result.jain = sum_squares > 0 ? sum * sum / (double(threads) * sum_squares) : 1.0;
+	result.min_share = fair_share > 0 ? min / fair_share : 0.0;
+	result.max_share = fair_share > 0 ? max / fair_share : 0.0;
+	return result;
+}
+
+
+static void print_row(const outcome& item, bool& header_printed) {
+	if (!header_printed) {
+		std::printf("%-13s %7s %5s %8s %12s %6s %5s %5s %8s %10s %10s %10s %10s %10s %4s\n",
+					"benchmark", "threads", "read", "hold[ns]", "ops/s", "jain", "min", "max", "starved",
+					"rd p50[ns]", "rd p99[ns]", "wr p50[ns]", "wr p99[ns]", "wr max[ns]", "bad");
+		header_printed = true;
+	}
+	std::printf("%-13s %7zu %5.2f %8lld %12.0f %6.3f %5.2f %5.2f %8llu %10lld %10lld %10lld %10lld %10lld %4llu\n",
+				item.name.c_str(), item.threads, item.read_ratio, static_cast<long long>(item.hold_ns),
+				item.ns_per_op.median > 0 ? 1e9 / item.ns_per_op.median : 0.0,
+				item.jain, item.min_share, item.max_share,
+				static_cast<unsigned long long>(item.starved_waits + item.starved_tasks),
+				static_cast<long long>(item.read_wait.percentile(0.5).count()),
+				static_cast<long long>(item.read_wait.percentile(0.99).count()),
+				static_cast<long long>(item.write_wait.percentile(0.5).count()),
+				static_cast<long long>(item.write_wait.percentile(0.99).count()),
+				static_cast<long long>(item.write_wait.max.count()),
+				static_cast<unsigned long long>(item.violations));
+	std::fflush(stdout);
+}
+
+
+static void print_json(const std::vector<outcome>& outcomes) {
+	std::printf("{\n\t\"mutex_stress\": [");
+	for (size_t i = 0; i < outcomes.size(); ++i) {
+		const outcome& item = outcomes[i];
+		auto wait = [](const latency_distribution& wait) {
+			char text[160];
+			std::snprintf(text, sizeof(text), "{ \"count\": %llu, \"p50\": %lld, \"p90\": %lld, \"p99\": %lld, \"max\": %lld }",
+						  static_cast<unsigned long long>(wait.count),
+						  static_cast<long long>(wait.percentile(0.5).count()),
+						  static_cast<long long>(wait.percentile(0.9).count()),
+						  static_cast<long long>(wait.percentile(0.99).count()),
+						  static_cast<long long>(wait.max.count()));
+			return std::string(text);
+		};
+		std::printf("%s\n\t\t{ \"name\": \"%s\", \"threads\": %zu, \"read_ratio\": %.3f, \"hold_ns\": %lld, \"acquisitions\": %llu, "
+					"\"ns_per_op\": { \"min\": %.2f, \"median\": %.2f, \"max\": %.2f }, "
+					"\"jain\": %.4f, \"min_share\": %.4f, \"max_share\": %.4f, \"starved_waits\": %llu, \"starved_tasks\": %llu, "
+					"\"read_wait_ns\": %s, \"write_wait_ns\": %s, \"violations\": %llu }",
+					i == 0 ? "" : ",", item.name.c_str(), item.threads, item.read_ratio, static_cast<long long>(item.hold_ns),
+					static_cast<unsigned long long>(item.acquisitions),
+					item.ns_per_op.min, item.ns_per_op.median, item.ns_per_op.max,
+					item.jain, item.min_share, item.max_share,
+					static_cast<unsigned long long>(item.starved_waits), static_cast<unsigned long long>(item.starved_tasks),
+					wait(item.read_wait).c_str(), wait(item.write_wait).c_str(),
+					static_cast<unsigned long long>(item.violations));
+	}
+	std::printf("\n\t]\n}\n");
+}
+
+
+int main(int argc, char* argv[]) {
+	stress_options stress_options;
+	const auto options = bench::options::parse(argc, argv, [&](std::string_view arg) { return stress_options.parse(arg); });
+
+	std::vector<outcome> outcomes;
+	bool header_printed = false;
+	auto add = [&](outcome item) {
+		if (!options.json) {
+			print_row(item, header_printed);
+		}
+		outcomes.push_back(std::move(item));
+	};
+
+	for (size_t threads : options.thread_counts()) {
+		for (int64_t hold_ns : stress_options.hold_ns) {
+			if (options.selected("mutex")) {
+				add(stress<mutex>(options, stress_options, "mutex", threads, 0.0, hold_ns));
+			}
+			if (options.selected("shared_mutex")) {
+				for (double read_ratio : stress_options.read_ratios) {
+					add(stress<shared_mutex>(options, stress_options, "shared_mutex", threads, read_ratio, hold_ns));
+				}
+			}
+		}
+	}
+	if (options.json) {
+		print_json(outcomes);
+	}
+
+	uint64_t violations = 0;
+	for (const auto& item : outcomes) {
+		violations += item.violations;
+	}
+	if (violations != 0) {
+		std::fprintf(stderr, "%llu mutual exclusion violations\n", static_cast<unsigned long long>(violations));
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,246 @@
+#pragma once
+
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <numeric>
+#include <optional>
+#include <ranges>
+#include <vector>
+
+
+namespace cppjobs::algorithms {
+
+namespace impl {
+
+	// Below these sizes, splitting costs more than it gains.
+	inline constexpr size_t sort_cutoff = 2048;
+	inline constexpr size_t merge_cutoff = 4096;
+	inline constexpr size_t transform_grain = 1024;
+	inline constexpr size_t block_size = 16384;
+	inline constexpr size_t max_blocks = 1024;
+
+	/// <summary> Awaits the inline part and the split off part, then rethrows the first exception. </summary>
+	inline future<void> join(future<void> inline_part, future<void> split_part) {
+		std::exception_ptr error;
+		try {
+			co_await inline_part;
+		}
+		catch (...) {
+			error = std::current_exception();
+		}
+		try {
+			co_await split_part;
+		}
+		catch (...) {
+			if (!error) {
+				error = std::current_exception();
+			}
+		}
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+
+	// Stable: of equal elements, those of the first run come first.
+	template <class In, class Out, class Compare>
+	future<void> merge(std::shared_ptr<scheduler> sched, In first1, In last1, In first2, In last2, Out out, const Compare* comp) {
+		const auto size1 = last1 - first1;
+		const auto size2 = last2 - first2;
+		if (size_t(size1 + size2) <= merge_cutoff || !sched->needs_work()) {
+			std::merge(std::make_move_iterator(first1), std::make_move_iterator(last1), std::make_move_iterator(first2), std::make_move_iterator(last2), out, *comp);
+			co_return;
+		}
+		In middle1;
+		In middle2;
+		if (size1 >= size2) {
+			middle1 = first1 + size1 / 2;
+			middle2 = std::lower_bound(first2, last2, *middle1, *comp);
+		}
+		else {
+			middle2 = first2 + size2 / 2;
+			middle1 = std::upper_bound(first1, last1, *middle2, *comp);
+		}
+		const auto upper_out = out + (middle1 - first1) + (middle2 - first2);
+		auto upper = sched->schedule(merge<In, Out, Compare>, sched, middle1, last1, middle2, last2, upper_out, comp);
+		upper.start();
+		co_await join(merge(sched, first1, middle1, first2, middle2, out, comp), std::move(upper));
+	}
+
+	// Sorts data, and leaves the result in buffer if into_buffer, in data otherwise.
+	// The halves go to the other array than the result, so that they can be merged into place.
+	template <class Data, class Buffer, class Compare>
+	future<void> merge_sort(std::shared_ptr<scheduler> sched, Data data, Buffer buffer, size_t size, bool into_buffer, const Compare* comp) {
+		if (size <= sort_cutoff || !sched->needs_work()) {
+			std::stable_sort(data, data + size, *comp);
+			if (into_buffer) {
+				std::move(data, data + size, buffer);
+			}
+			co_return;
+		}
+		const size_t half = size / 2;
+		auto upper = sched->schedule(merge_sort<Data, Buffer, Compare>, sched, data + half, buffer + half, size - half, !into_buffer, comp);
+		upper.start();
+		co_await join(merge_sort(sched, data, buffer, half, !into_buffer, comp), std::move(upper));
+		if (into_buffer) {
+			co_await merge(sched, data, data + half, data + half, data + size, buffer, comp);
+		}
+		else {
+			co_await merge(sched, buffer, buffer + half, buffer + half, buffer + size, data, comp);
+		}
+	}
+
+	inline size_t num_blocks(size_t size) {
+		return std::clamp((size + block_size - 1) / block_size, size_t(1), max_blocks);
+	}
+
+	template <class View, class Compare>
+	future<void> sort(std::shared_ptr<scheduler> sched, View view, Compare comp) {
+		const auto first = std::ranges::begin(view);
+		const size_t size = size_t(std::ranges::distance(view));
+		if (size <= sort_cutoff) {
+			std::stable_sort(first, first + size, comp);
+			co_return;
+		}
+		std::vector<std::iter_value_t<decltype(first)>> buffer(size);
+		co_await merge_sort(sched, first, buffer.begin(), size, false, &comp);
+	}
+
+	template <class View, class Out, class Op>
+	future<void> transform(std::shared_ptr<scheduler> sched, View view, Out out, Op op) {
+		const auto first = std::ranges::begin(view);
+		const auto size = std::ranges::distance(view);
+		co_await parallel_for(
+			sched, std::views::iota(decltype(size)(0), size), [first, out, &op](auto index) { out[index] = std::invoke(op, first[index]); }, transform_grain);
+	}
+
+	// Blocked scan: sum each block in parallel, scan the block sums serially, then scan each block in parallel from its offset.
+	template <class View, class Out, class T, class Op>
+	future<void> scan(std::shared_ptr<scheduler> sched, View view, Out out, std::optional<T> init, Op op, bool inclusive) {
+		const auto first = std::ranges::begin(view);
+		const size_t size = size_t(std::ranges::distance(view));
+		if (size == 0) {
+			co_return;
+		}
+		const size_t blocks = num_blocks(size);
+		const auto block_first = [first, size, blocks](size_t block) { return first + block * size / blocks; };
+
+		std::vector<std::optional<T>> offsets(blocks);
+		co_await parallel_for(sched, std::views::iota(size_t(0), blocks - 1), [&](size_t block) {
+			const auto block_begin = block_first(block);
+			offsets[block + 1] = std::accumulate(std::next(block_begin), block_first(block + 1), T(*block_begin), op);
+		});
+		offsets[0] = init;
+		for (size_t block = 1; block < blocks; ++block) {
+			if (offsets[block - 1]) {
+				offsets[block] = std::invoke(op, std::move(*offsets[block - 1]), std::move(*offsets[block]));
+			}
+		}
+		co_await parallel_for(sched, std::views::iota(size_t(0), blocks), [&](size_t block) {
+			const auto block_begin = block_first(block);
+			const auto block_end = block_first(block + 1);
+			const auto block_out = out + (block_begin - first);
+			if (inclusive && offsets[block]) {
+				std::inclusive_scan(block_begin, block_end, block_out, op, *offsets[block]);
+			}
+			else if (inclusive) {
+				std::inclusive_scan(block_begin, block_end, block_out, op);
+			}
+			else {
+				std::exclusive_scan(block_begin, block_end, block_out, *offsets[block], op);
+			}
+		});
+	}
+
+	// Counts the matches of each block, then moves every element straight to its final place in a buffer.
+	template <class View, class Pred>
+	future<std::ranges::iterator_t<View>> partition(std::shared_ptr<scheduler> sched, View view, Pred pred) {
+		const auto first = std::ranges::begin(view);
+		const size_t size = size_t(std::ranges::distance(view));
+		const size_t blocks = num_blocks(size);
+		const auto block_first = [first, size, blocks](size_t block) { return first + block * size / blocks; };
+
+		std::vector<size_t> matches(blocks + 1, 0);
+		co_await parallel_for(sched, std::views::iota(size_t(0), blocks), [&](size_t block) {
+			matches[block + 1] = size_t(std::count_if(block_first(block), block_first(block + 1), std::ref(pred)));
+		});
+		std::partial_sum(matches.begin(), matches.end(), matches.begin());
+		const size_t total = matches.back();
+
+		std::vector<std::iter_value_t<decltype(first)>> buffer(size);
+		co_await parallel_for(sched, std::views::iota(size_t(0), blocks), [&](size_t block) {
+			const auto block_begin = block_first(block);
+			const size_t before = size_t(block_begin - first);
+			auto matching = buffer.begin() + matches[block];
+			auto rest = buffer.begin() + total + (before - matches[block]);
+			for (auto it = block_begin; it != block_first(block + 1); ++it) {
+				*(std::invoke(pred, *it) ? matching++ : rest++) = std::move(*it);
+			}
+		});
+		co_await transform(sched, std::views::all(buffer), first, [](auto& value) { return std::move(value); });
+		co_return first + total;
+	}
+
+} // namespace impl
+
+
+/// <summary>
+/// Stable parallel merge sort. Halves are sorted in parallel and merged by a parallel merge,
+/// using a buffer as large as the range. The value type must be default constructible.
+/// </summary>
+/// <remarks> Like parallel_for, the range is referenced if it's an lvalue, and must outlive the future. </remarks>
+template <std::ranges::random_access_range Range, class Compare = std::ranges::less>
+	requires std::ranges::sized_range<Range>
+future<void> sort(std::shared_ptr<scheduler> sched, Range&& range, Compare comp = {}) {
+	auto view = std::views::all(std::forward<Range>(range));
+	return sched->schedule(impl::sort<decltype(view), Compare>, sched, std::move(view), std::move(comp));
+}
+
+
+/// <summary> Writes op(element) to out for each element of the range, in parallel. </summary>
+template <std::ranges::random_access_range Range, std::random_access_iterator Out, class Op>
+	requires std::ranges::sized_range<Range>
+future<void> transform(std::shared_ptr<scheduler> sched, Range&& range, Out out, Op op) {
+	auto view = std::views::all(std::forward<Range>(range));
+	return sched->schedule(impl::transform<decltype(view), Out, Op>, sched, std::move(view), out, std::move(op));
+}
+
+
+/// <summary>
+/// Writes the inclusive prefix sums of the range to out. The range is scanned in blocks,
+/// which takes two passes over the data, but both are parallel. op must be associative. Out may be the range's beginning.
+/// </summary>
+template <std::ranges::random_access_range Range, std::random_access_iterator Out, class Op = std::plus<>>
+	requires std::ranges::sized_range<Range>
+future<void> inclusive_scan(std::shared_ptr<scheduler> sched, Range&& range, Out out, Op op = {}) {
+	using value_t = std::ranges::range_value_t<Range>;
+	auto view = std::views::all(std::forward<Range>(range));
+	return sched->schedule(impl::scan<decltype(view), Out, value_t, Op>, sched, std::move(view), out, std::optional<value_t>{}, std::move(op), true);
+}
+
+
+/// <summary> Like inclusive_scan, but each element's sum leaves the element out and starts from init. </summary>
+template <std::ranges::random_access_range Range, std::random_access_iterator Out, class T, class Op = std::plus<>>
+	requires std::ranges::sized_range<Range>
+future<void> exclusive_scan(std::shared_ptr<scheduler> sched, Range&& range, Out out, T init, Op op = {}) {
+	auto view = std::views::all(std::forward<Range>(range));
+	return sched->schedule(impl::scan<decltype(view), Out, T, Op>, sched, std::move(view), out, std::optional<T>{ std::move(init) }, std::move(op), false);
+}
+
+
+/// <summary>
+/// Stable parallel partition: elements satisfying pred go to the front, in their original order, followed by the rest.
+/// Returns the beginning of the second group. Uses a buffer as large as the range.
+/// </summary>
+template <std::ranges::random_access_range Range, class Pred>
+	requires std::ranges::sized_range<Range>
+auto partition(std::shared_ptr<scheduler> sched, Range&& range, Pred pred) {
+	auto view = std::views::all(std::forward<Range>(range));
+	return sched->schedule(impl::partition<decltype(view), Pred>, sched, std::move(view), std::move(pred));
+}
+
+
+} // namespace cppjobs::algorithms
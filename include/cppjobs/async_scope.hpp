@@ -0,0 +1,112 @@
+#pragma once
+
+#include "awaitable_node.hpp"
+#include "scheduler_base.hpp"
+#include "type_traits.hpp"
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+
+
+namespace cppjobs {
+
+/// <summary>
+/// Structured fork-join: a coroutine spawns children onto a scheduler, then awaits join().
+/// Children are counted by a single atomic instead of each being tracked by a future, and a child's
+/// frame is freed the moment it finishes. Since no child outlives the join, children can safely refer to
+/// the parent's locals, through reference captures or std::ref arguments, instead of copying them.
+/// </summary>
+/// <remarks>
+/// A scope must be joined before it's destroyed, or std::terminate is called, like for std::thread.
+/// Children may spawn more children into the same scope. After a join, the scope can be reused.
+/// join() rethrows the first exception thrown by a child.
+/// </remarks>
+class async_scope {
+	struct child_task;
+	struct join_awaitable;
+
+public:
+	explicit async_scope(std::shared_ptr<scheduler_base> sched);
+	async_scope(const async_scope&) = delete;
+	async_scope& operator=(const async_scope&) = delete;
+	~async_scope();
+
+	/// <summary>
+	/// Queues func(args...) on the scheduler. If func returns an awaitable, the child ends when that does.
+	/// Arguments are decay-copied, like for std::thread.
+	/// </summary>
+	template <class Func, class... Args>
+	void spawn(Func func, Args&&... args);
+	/// <summary> Awaitable that resumes once all children have finished. </summary>
+	join_awaitable join();
+
+private:
+	template <class Func, class... Args>
+	static child_task run_child(Func func, Args... args);
+	void launch(child_task child);
+	void record(std::exception_ptr error);
+
+private:
+	std::shared_ptr<scheduler_base> m_scheduler;
+	/// <summary> Running children, plus one for the joiner until it suspends. </summary>
+	std::atomic_size_t m_pending = 1;
+	awaitable_node m_joiner;
+	std::mutex m_error_mtx;
+	std::exception_ptr m_error;
+};
+
+
+struct async_scope::child_task {
+	struct final_awaitable {
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> child) const noexcept;
+		void await_resume() const noexcept {}
+		async_scope* m_scope;
+	};
+	struct promise_type : schedulable_promise {
+		child_task get_return_object() { return { std::coroutine_handle<promise_type>::from_promise(*this) }; }
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		final_awaitable final_suspend() noexcept { return { m_scope }; }
+		void return_void() {}
+		void unhandled_exception() { m_scope->record(std::current_exception()); }
+		async_scope* m_scope = nullptr;
+	};
+	std::coroutine_handle<promise_type> m_handle;
+};
+
+
+struct async_scope::join_awaitable {
+	bool await_ready() const noexcept { return false; }
+	template <class Promise>
+	bool await_suspend(std::coroutine_handle<Promise> joiner) {
+		m_scope->m_joiner.set_waiting(joiner);
+		return m_scope->m_pending.fetch_sub(1) != 1;
+	}
+	void await_resume();
+	async_scope* m_scope;
+};
+
+
+template <class Func, class... Args>
+void async_scope::spawn(Func func, Args&&... args) {
+	launch(run_child<Func, std::decay_t<Args>...>(std::move(func), std::forward<Args>(args)...));
+}
+
+
+template <class Func, class... Args>
+auto async_scope::run_child(Func func, Args... args) -> child_task {
+	if constexpr (awaitable<std::invoke_result_t<Func&, Args&...>>) {
+		co_await std::invoke(func, args...);
+	}
+	else {
+		std::invoke(func, args...);
+	}
+}
+
+
+} // namespace cppjobs
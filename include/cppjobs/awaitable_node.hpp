@@ -2,8 +2,11 @@
 
 #include "scheduler_base.hpp"
 
+#include <array>
+#include <concepts>
 #include <coroutine>
 #include <condition_variable>
+#include <mutex>
 
 
 namespace cppjobs {
@@ -13,7 +16,7 @@ struct awaitable_node {
 	template <class Promise>
 	void set_waiting(std::coroutine_handle<Promise> handle) {
 		m_waiting = handle;
-		if constexpr (std::convertible_to<Promise, schedulable_promise>) {
+		if constexpr (std::derived_from<Promise, schedulable_promise>) {
 			m_scheduler = handle.promise().m_scheduler;
 		}
 	}
@@ -31,21 +34,66 @@ private:
 struct sync_awaitable_node {
 	sync_awaitable_node* m_next = nullptr;
 	std::condition_variable* m_cv = nullptr;
+	std::mutex* m_mtx = nullptr;
+	bool m_notified = false;
+	/// <summary> Called instead of resuming anything, for continuations attached by future::then. </summary>
+	void (*m_callback)(sync_awaitable_node* self) = nullptr;
 	template <class Promise>
 	void set_waiting(std::coroutine_handle<Promise> handle) {
 		m_waiting = handle;
-		if constexpr (std::convertible_to<Promise, schedulable_promise>) {
+		if constexpr (std::derived_from<Promise, schedulable_promise>) {
 			m_scheduler = handle.promise().m_scheduler;
 		}
 	}
 	void resume() {
+		// Either a coroutine, a callback or a blocked thread waits on a node, never more. Once the coroutine
+		// is resumed the node may be gone, so m_cv must not be read after that.
 		if (m_waiting) {
 			m_scheduler ? m_scheduler->queue_for_resume(m_waiting) : m_waiting.resume();
 		}
-		if (m_cv) {
+		else if (m_callback) {
+			m_callback(this); // May free the node.
+		}
+		else if (m_cv) {
+			// The blocked thread owns this node, it may only return once we're done touching it.
+			std::lock_guard lk(*m_mtx);
+			m_notified = true;
 			m_cv->notify_all();
 		}
 	}
+	/// <summary>
+	/// Resumes every node of the list. Coroutines that go to the same scheduler are handed over in batches,
+	/// so that a crowd of waiters on a single event is spread over the workers instead of queued one by one.
+	/// </summary>
+	static void resume_all(sync_awaitable_node* node) noexcept {
+		std::array<std::coroutine_handle<>, 64> batch;
+		size_t count = 0;
+		std::shared_ptr<scheduler_base> scheduler; // The nodes may be gone once their coroutine is queued.
+		const auto flush = [&] {
+			if (count != 0) {
+				scheduler->queue_for_resume_batch({ batch.data(), count });
+				count = 0;
+			}
+		};
+		while (node != nullptr) {
+			auto next = node->m_next; // The node may get destructed while we resume it.
+			if (node->m_waiting && node->m_scheduler) {
+				if (node->m_scheduler != scheduler) {
+					flush();
+					scheduler = node->m_scheduler;
+				}
+				batch[count++] = node->m_waiting;
+				if (count == batch.size()) {
+					flush();
+				}
+			}
+			else {
+				node->resume();
+			}
+			node = next;
+		}
+		flush();
+	}
 private:
 	std::shared_ptr<scheduler_base> m_scheduler = nullptr;
 	std::coroutine_handle<> m_waiting = nullptr;
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace cppjobs {
+
+enum class await_kind : uint8_t {
+	none, ///< Running, not started, or suspended on something the registry doesn't know.
+	mutex, ///< Waiting for a mutex, the edge goes to the coroutine holding it.
+	future, ///< Waiting for a future, the edge goes to the coroutine computing it.
+};
+
+
+/// <summary>
+/// The registry's entry of a live coroutine. Promises have one as m_record in builds with
+/// CPPJOBS_COROUTINE_REGISTRY defined, and mutexes and futures fill it in when they suspend the coroutine.
+/// </summary>
+class coroutine_record {
+	friend class coroutine_registry;
+	friend struct act_for_awaiter;
+
+public:
+	coroutine_record();
+	~coroutine_record();
+	coroutine_record(const coroutine_record&) = delete;
+	coroutine_record& operator=(const coroutine_record&) = delete;
+
+	/// <summary> Unique for the life of the process, unlike frame addresses. Never zero. </summary>
+	uint64_t id() const { return m_id; }
+	void set_label(std::string_view label);
+	/// <summary> Call before the coroutine is published to whoever resumes it, the frame may be gone after. </summary>
+	void waits_on(await_kind kind, const void* object, uint64_t target) noexcept;
+	/// <summary> The coroutine waited for changed, e.g. the mutex changed hands. Only while suspended, by whoever may resume it. </summary>
+	void waits_for(uint64_t target) noexcept { m_target.store(target, std::memory_order_relaxed); }
+	void resumed() noexcept;
+	/// <summary> Set by the coroutine that awaits this one's future, before starting it. </summary>
+	void awaited_by(uint64_t id) noexcept { m_awaited_by.store(id, std::memory_order_relaxed); }
+	/// <summary>
+	/// The id mutexes record as their owner when this coroutine locks them: its own, or for a lock helper
+	/// (see act_for_awaiter) the id of the coroutine awaiting it, which is the one that ends up holding the lock.
+	/// </summary>
+	uint64_t owner_id() const noexcept {
+		const uint64_t awaiter = m_acts_for_awaiter ? m_awaited_by.load(std::memory_order_relaxed) : 0;
+		return awaiter != 0 ? awaiter : m_id;
+	}
+
+	/// <summary> The record of the coroutine, nullptr if its promise has none. </summary>
+	template <class Promise>
+	static coroutine_record* of(std::coroutine_handle<Promise> handle) {
+		if constexpr (requires { handle.promise().m_record; }) {
+			return &handle.promise().m_record;
+		}
+		else {
+			return nullptr;
+		}
+	}
+
+private:
+	static int64_t now() noexcept;
+
+private:
+	const uint64_t m_id;
+	coroutine_record* m_prev = nullptr;
+	coroutine_record* m_next = nullptr;
+	const size_t m_shard;
+	/// <summary> Guarded by the shard's lock, the rest is written without it. </summary>
+	std::string m_label;
+	std::atomic<await_kind> m_kind = await_kind::none;
+	std::atomic<const void*> m_object = nullptr;
+	std::atomic_uint64_t m_target = 0;
+	std::atomic_int64_t m_suspended_at = 0;
+	std::atomic_uint64_t m_awaited_by = 0;
+	/// <summary> Only the coroutine itself writes it. </summary>
+	bool m_acts_for_awaiter = false;
+};
+
+
+/// <summary>
+/// Labels the awaiting coroutine in the registry's dumps, e.g. co_await label_coroutine("flush cache").
+/// Doesn't suspend, and does nothing without CPPJOBS_COROUTINE_REGISTRY.
+/// </summary>
+struct label_coroutine {
+	bool await_ready() const noexcept { return false; }
+	template <class Promise>
+	bool await_suspend(std::coroutine_handle<Promise> handle) const {
+		if (auto record = coroutine_record::of(handle)) {
+			record->set_label(m_label);
+		}
+		return false;
+	}
+	void await_resume() const noexcept {}
+	std::string_view m_label;
+};
+
+
+/// <summary>
+/// Marks the awaiting coroutine as a lock helper, like the coroutines behind shared_mutex's lock and lock_shared:
+/// the mutexes it locks are recorded as held by the coroutine awaiting it. Doesn't suspend.
+/// </summary>
+struct act_for_awaiter {
+	bool await_ready() const noexcept { return false; }
+	template <class Promise>
+	bool await_suspend(std::coroutine_handle<Promise> handle) const noexcept {
+		if (auto record = coroutine_record::of(handle)) {
+			record->m_acts_for_awaiter = true;
+		}
+		return false;
+	}
+	void await_resume() const noexcept {}
+};
+
+
+struct coroutine_info {
+	uint64_t id = 0;
+	std::string label;
+	await_kind kind = await_kind::none;
+	/// <summary> The mutex or the frame of the future waited for. </summary>
+	const void* object = nullptr;
+	/// <summary> The coroutine waited for: the holder of the mutex or the one computing the future. Zero if unknown. </summary>
+	uint64_t waits_for = 0;
+	std::chrono::nanoseconds suspended_for{ 0 };
+};
+
+
+/// <summary>
+/// Keeps track of the live coroutines and what they are waiting for, to diagnose stalls and deadlocks.
+/// Only compiled in with CPPJOBS_COROUTINE_REGISTRY defined (the ENABLE_COROUTINE_REGISTRY CMake option),
+/// otherwise it's always empty.
+/// </summary>
+/// <remarks>
+/// Coroutines are registered in per-thread shards, which costs an uncontended lock when a frame is created and freed.
+/// Snapshots only read the records, never the mutexes or futures waited for. The holder of a mutex updates the
+/// records of its waiters whenever it hands the mutex on, and each one records the holder it finds when it queues.
+/// Mutexes only know the coroutine that holds them if it locked them with co_await, or through shared_mutex.
+/// A shared_mutex locked by several readers is recorded as held by the first of them, until the last one unlocks it.
+/// </remarks>
+class coroutine_registry {
+public:
+#ifdef CPPJOBS_COROUTINE_REGISTRY
+	static constexpr bool enabled = true;
+#else
+	static constexpr bool enabled = false;
+#endif
+
+	/// <summary> All live coroutines, those waiting the longest first. </summary>
+	static std::vector<coroutine_info> snapshot();
+	/// <summary> Cycles of the wait-for graph of the snapshot, as lists of coroutine ids. Each one is a deadlock. </summary>
+	static std::vector<std::vector<uint64_t>> find_cycles(const std::vector<coroutine_info>& coroutines);
+	/// <summary> Prints the waiting coroutines, what they wait for, and the deadlocks. </summary>
+	static void dump(std::ostream& out);
+	/// <summary>
+	/// Dumps to stderr whenever the process receives the signal, e.g. SIGUSR1 in a stalled process.
+	/// The handler only sets a flag, a background thread takes the snapshot.
+	/// </summary>
+	static void dump_on_signal(int signal);
+};
+
+
+} // namespace cppjobs
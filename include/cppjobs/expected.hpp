@@ -0,0 +1,111 @@
+#pragma once
+
+#include <exception>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#if __has_include(<expected>)
+#include <expected>
+#endif
+
+
+namespace cppjobs {
+
+#if defined(__cpp_lib_expected)
+
+using std::bad_expected_access;
+using std::expected;
+using std::unexpected;
+
+#else
+
+/// <summary> Wraps an error value, to construct an expected holding an error. Same as C++23 std::unexpected. </summary>
+template <class E>
+class unexpected {
+public:
+	constexpr explicit unexpected(E error) : m_error(std::move(error)) {}
+
+	constexpr const E& error() const& noexcept { return m_error; }
+	constexpr E& error() & noexcept { return m_error; }
+	constexpr E&& error() && noexcept { return std::move(m_error); }
+
+private:
+	E m_error;
+};
+
+
+template <class E>
+class bad_expected_access : public std::exception {
+public:
+	explicit bad_expected_access(E error) : m_error(std::move(error)) {}
+	const char* what() const noexcept override { return "bad access to expected without value"; }
+	const E& error() const noexcept { return m_error; }
+
+private:
+	E m_error;
+};
+
+
+/// <summary>
+/// Either a value or an error, to report failures as values instead of exceptions.
+/// A subset of C++23 std::expected, which it's an alias of where the standard library has it.
+/// </summary>
+template <class T, class E>
+class expected {
+public:
+	using value_type = T;
+	using error_type = E;
+
+	constexpr expected() requires std::is_default_constructible_v<T> : m_storage(std::in_place_index<0>) {}
+	template <class U = T>
+		requires std::is_constructible_v<T, U&&> && (!std::is_same_v<std::remove_cvref_t<U>, expected>)
+	constexpr expected(U&& value) : m_storage(std::in_place_index<0>, std::forward<U>(value)) {}
+	template <class G>
+	constexpr expected(unexpected<G> error) : m_storage(std::in_place_index<1>, std::move(error).error()) {}
+
+	constexpr bool has_value() const noexcept { return m_storage.index() == 0; }
+	constexpr explicit operator bool() const noexcept { return has_value(); }
+
+	constexpr T& value() & {
+		check();
+		return *std::get_if<0>(&m_storage);
+	}
+	constexpr const T& value() const& {
+		check();
+		return *std::get_if<0>(&m_storage);
+	}
+	constexpr T&& value() && {
+		check();
+		return std::move(*std::get_if<0>(&m_storage));
+	}
+	template <class U>
+	constexpr T value_or(U&& fallback) const& {
+		return has_value() ? **this : static_cast<T>(std::forward<U>(fallback));
+	}
+
+	constexpr T& operator*() & noexcept { return *std::get_if<0>(&m_storage); }
+	constexpr const T& operator*() const& noexcept { return *std::get_if<0>(&m_storage); }
+	constexpr T&& operator*() && noexcept { return std::move(*std::get_if<0>(&m_storage)); }
+	constexpr T* operator->() noexcept { return std::get_if<0>(&m_storage); }
+	constexpr const T* operator->() const noexcept { return std::get_if<0>(&m_storage); }
+
+	constexpr E& error() & noexcept { return *std::get_if<1>(&m_storage); }
+	constexpr const E& error() const& noexcept { return *std::get_if<1>(&m_storage); }
+	constexpr E&& error() && noexcept { return std::move(*std::get_if<1>(&m_storage)); }
+
+private:
+	constexpr void check() const {
+		if (!has_value()) {
+			throw bad_expected_access<E>(error());
+		}
+	}
+
+private:
+	std::variant<T, E> m_storage;
+};
+
+#endif
+
+
+} // namespace cppjobs
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <source_location>
+#include <vector>
+
+
+namespace cppjobs {
+
+struct frame_site_stats {
+	/// <summary> The coroutine function, as the compiler names it. </summary>
+	const char* function = "";
+	const char* file = "";
+	uint32_t line = 0;
+	/// <summary> Each instance of a function template is a separate function. </summary>
+	size_t frame_size = 0;
+	uint64_t allocations = 0;
+	uint64_t live_frames = 0;
+	uint64_t live_bytes = 0;
+};
+
+
+struct frame_stats {
+	/// <summary> Counters only grow, the allocation rate is the difference of two snapshots. </summary>
+	uint64_t allocations = 0;
+	uint64_t allocated_bytes = 0;
+	uint64_t live_frames = 0;
+	uint64_t live_bytes = 0;
+	/// <summary> Each coroutine function, the most live bytes first. </summary>
+	std::vector<frame_site_stats> sites;
+};
+
+
+/// <summary>
+/// Counts coroutine frames by the function they belong to: their size, how many are alive and how many bytes they hold.
+/// The promises of futures and async_scope report to it in builds with CPPJOBS_FRAME_ACCOUNTING defined
+/// (the ENABLE_FRAME_ACCOUNTING CMake option), otherwise it's always empty.
+/// </summary>
+/// <remarks>
+/// The function is identified by the std::source_location of the promise's operator new call, which the compiler
+/// places in the coroutine. Each frame gets a small header to find its function when it's freed.
+/// Allocating a frame costs a lock-free lookup of the function and an atomic increment. The counters of a function
+/// are shared by all threads, so creating the same coroutine on many threads at once contends on them a little.
+/// </remarks>
+class frame_accounting {
+	struct site;
+	struct site_table;
+
+public:
+#ifdef CPPJOBS_FRAME_ACCOUNTING
+	static constexpr bool enabled = true;
+#else
+	static constexpr bool enabled = false;
+#endif
+
+	static void* allocate(size_t size, const std::source_location& location);
+	static void deallocate(void* ptr, size_t size) noexcept;
+
+	static frame_stats snapshot();
+	/// <summary> Prints the count functions with the most live bytes as a table. </summary>
+	static void report(std::ostream& out, size_t count = 20);
+
+private:
+	static site& find_site(const std::source_location& location);
+	static site_table& sites();
+
+private:
+	/// <summary> Keeps the frame behind it aligned for anything new would align it for. </summary>
+	static constexpr size_t header_size = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+};
+
+
+} // namespace cppjobs
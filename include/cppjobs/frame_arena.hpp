@@ -0,0 +1,54 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <mutex>
+
+
+namespace cppjobs {
+
+/// <summary>
+/// Pool allocator for coroutine frames.
+/// Threads bound to an arena take frames from it through a small thread-local cache,
+/// other threads use the global heap. Blocks always go back to the arena they came from,
+/// no matter which thread frees them, so memory stays where it was first touched.
+/// </summary>
+class frame_arena {
+	struct block {
+		block* m_next;
+	};
+	struct thread_cache;
+
+public:
+	static constexpr size_t num_size_classes = 7; // 64 bytes to 4 kiB, powers of two.
+	static constexpr size_t min_block_size = 64;
+	static constexpr size_t max_block_size = min_block_size << (num_size_classes - 1);
+
+	frame_arena(const frame_arena&) = delete;
+	frame_arena& operator=(const frame_arena&) = delete;
+
+	/// <summary> The arena of the NUMA node. Arenas live until the process exits. </summary>
+	static frame_arena& for_node(size_t node);
+	/// <summary> Frames allocated by the calling thread will come from this arena. nullptr means the global heap. </summary>
+	static void bind_thread(frame_arena* arena);
+	static frame_arena* bound_arena();
+
+	static void* allocate(size_t size);
+	static void deallocate(void* ptr, size_t size) noexcept;
+
+private:
+	frame_arena() = default;
+	void refill(thread_cache& cache, size_t size_class);
+	void release(block* first, block* last, size_t size_class);
+
+private:
+	std::mutex m_mtx;
+	std::array<block*, num_size_classes> m_free = {};
+	std::byte* m_chunk_cursor = nullptr;
+	std::byte* m_chunk_end = nullptr;
+
+	static thread_local thread_cache tls_cache;
+};
+
+
+} // namespace cppjobs
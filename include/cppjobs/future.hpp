@@ -1,11 +1,13 @@
 #pragma once
 
 #include <coroutine>
+#include <functional>
 #include <future>
 #include <new>
 #include <cassert>
 #include <variant>
 #include "awaitable_node.hpp"
+#include "trace.hpp"
 
 
 namespace cppjobs {
@@ -29,9 +31,12 @@ class future {
 	using promise_storage = std::conditional_t<std::is_void_v<T>, promise_storage_void, promise_storage_full>;
 
 public:
-	struct promise_type : promise_storage, schedulable_promise {
+	// The result is placed right before the state, so that small results share a cache line with m_waiting,
+	// which the thread that finishes the coroutine and the one that picks up the result both touch.
+	struct promise_type : schedulable_promise, promise_storage {
 		using typename promise_storage::stored_t;
 
+		promise_type() { tracer::record(trace_event::create, std::coroutine_handle<promise_type>::from_promise(*this).address()); }
 		auto get_return_object() { return future{ std::coroutine_handle<promise_type>::from_promise(*this) }; }
 		auto initial_suspend() noexcept { return std::suspend_always{}; }
 		auto final_suspend() noexcept;
@@ -47,11 +52,11 @@ public:
 		void wait_destroy();
 
 	private:
-		std::atomic_flag m_started;
 		std::atomic<sync_awaitable_node*> m_waiting = nullptr;
 		static inline sync_awaitable_node* const FINISHED = reinterpret_cast<sync_awaitable_node*>(std::numeric_limits<size_t>::max());
+		std::atomic_flag m_started;
+		std::atomic_bool m_can_destroy = false;
 		std::atomic_size_t m_refcount = 0;
-		volatile bool m_can_destroy = false;
 	};
 	using handle_type = std::coroutine_handle<promise_type>;
 
@@ -59,12 +64,34 @@ public:
 		bool await_ready() { return m_handle.promise().finished(); }
 		template <class Promise>
 		bool await_suspend(std::coroutine_handle<Promise> waiting) {
+#ifdef CPPJOBS_COROUTINE_REGISTRY
+			m_record = coroutine_record::of(waiting);
+			if (m_record != nullptr) {
+				m_record->waits_on(await_kind::future, m_handle.address(), m_handle.promise().m_record.id());
+				m_handle.promise().m_record.awaited_by(m_record->id());
+			}
+#endif
 			m_handle.promise().start();
 			set_waiting(waiting);
 			return m_handle.promise().chain(this);
 		}
-		T await_resume() { return std::move(m_handle.promise().get()); }
+		T await_resume() {
+#ifdef CPPJOBS_COROUTINE_REGISTRY
+			if (m_record != nullptr) {
+				m_record->resumed();
+			}
+#endif
+			if constexpr (std::is_void_v<T>) {
+				m_handle.promise().get(); // Rethrows.
+			}
+			else {
+				return std::move(m_handle.promise().get());
+			}
+		}
 		handle_type m_handle;
+#ifdef CPPJOBS_COROUTINE_REGISTRY
+		coroutine_record* m_record = nullptr;
+#endif
 	};
 
 public:
@@ -74,6 +101,20 @@ public:
 	~future();
 
 	bool valid() const noexcept;
+	/// <summary> Queues the coroutine on its scheduler without waiting for it. Does nothing if it's already running. </summary>
+	void start() const;
+	/// <summary>
+	/// Starts the coroutine, and hands this future to func when it finishes, leaving this one invalid.
+	/// func runs inline on the thread that finishes the coroutine, or right away if it's finished already.
+	/// Unlike awaiting in a new coroutine, this needs no frame and no trip through the scheduler,
+	/// just a small node for func. func must not throw, get() on the future it receives may.
+	/// </summary>
+	/// <remarks>
+	/// Whatever func returns is dropped, so steps can't be chained into a new future with then.
+	/// To map the result, await the future in a coroutine instead.
+	/// </remarks>
+	template <class Func>
+	void then(Func func) &&;
 	void wait() const;
 	T get();
 	auto operator co_await() const;
@@ -89,6 +130,10 @@ protected:
 	future(const future&) noexcept;
 	future& operator=(const future&) noexcept;
 	future(handle_type handle) noexcept;
+
+	/// <summary> The common part of future::then and shared_future::then, func receives ready. </summary>
+	template <class Ready, class Func>
+	static void call_when_finished(Ready ready, Func func);
 protected:
 	handle_type m_handle = nullptr;
 };
@@ -100,18 +145,38 @@ class shared_future : public future<T> {
 		bool await_ready() { return m_handle.promise().finished(); }
 		template <class Promise>
 		bool await_suspend(std::coroutine_handle<Promise> waiting) {
+#ifdef CPPJOBS_COROUTINE_REGISTRY
+			m_record = coroutine_record::of(waiting);
+			if (m_record != nullptr) {
+				m_record->waits_on(await_kind::future, m_handle.address(), m_handle.promise().m_record.id());
+				m_handle.promise().m_record.awaited_by(m_record->id());
+			}
+#endif
 			m_handle.promise().start();
 			set_waiting(waiting);
 			return m_handle.promise().chain(this);
 		}
-		T& await_resume() { return m_handle.promise().get(); }
+		T& await_resume() {
+#ifdef CPPJOBS_COROUTINE_REGISTRY
+			if (m_record != nullptr) {
+				m_record->resumed();
+			}
+#endif
+			return m_handle.promise().get();
+		}
 		typename future<T>::handle_type m_handle;
+#ifdef CPPJOBS_COROUTINE_REGISTRY
+		coroutine_record* m_record = nullptr;
+#endif
 	};
 
 public:
 	shared_future(future<T>&& fut) : future<T>(std::move(fut)) {}
 	using future<T>::future;
 
+	/// <summary> Like future::then, but func receives a copy of this future, and this one stays valid. </summary>
+	template <class Func>
+	void then(Func func) const;
 	auto get() const -> std::conditional_t<std::is_void_v<T>, void, std::add_lvalue_reference_t<T>>;
 	auto operator co_await() const;
 };
@@ -146,14 +211,10 @@ future<T>::~future() {
 template <class T>
 auto future<T>::promise_type::final_suspend() noexcept {
 	// Set state to finished.
+	tracer::record(trace_event::finish, std::coroutine_handle<promise_type>::from_promise(*this).address());
 	sync_awaitable_node* waiting = m_waiting.exchange(FINISHED);
-	const sync_awaitable_node* first = waiting;
 	// Continue chains.
-	while (waiting != nullptr) {
-		auto next = waiting->m_next; // Waiting may get destructed while we resume it.
-		waiting->resume();
-		waiting = next;
-	}
+	sync_awaitable_node::resume_all(waiting);
 	// Cleanup awaiter.
 	struct awaitable {
 		bool await_ready() const noexcept {
@@ -171,11 +232,11 @@ auto future<T>::promise_type::final_suspend() noexcept {
 
 template <class T>
 auto future<T>::promise_type::get() -> stored_t& {
-	if (std::holds_alternative<std::exception_ptr>(this->m_value)) {
-		std::rethrow_exception(std::get<std::exception_ptr>(this->m_value));
+	if (auto value = std::get_if<stored_t>(&this->m_value)) {
+		return *value;
 	}
-	if (std::holds_alternative<stored_t>(this->m_value)) {
-		return std::get<stored_t>(this->m_value);
+	if (auto exception = std::get_if<std::exception_ptr>(&this->m_value)) {
+		std::rethrow_exception(*exception);
 	}
 	assert(false);
 	std::terminate();
@@ -185,6 +246,7 @@ template <class T>
 void future<T>::promise_type::start() {
 	auto my_handle = std::coroutine_handle<promise_type>::from_promise(*this);
 	if (!m_started.test_and_set()) {
+		tracer::record(trace_event::start, my_handle.address());
 		add_ref();
 		m_scheduler ? m_scheduler->queue_for_resume(my_handle) : my_handle.resume();
 	}
@@ -218,21 +280,67 @@ bool future<T>::valid() const noexcept {
 	return static_cast<bool>(m_handle);
 }
 
+template <class T>
+void future<T>::start() const {
+	if (!valid()) {
+		throw std::future_error{ std::future_errc::no_state };
+	}
+	m_handle.promise().start();
+}
+
+template <class T>
+template <class Func>
+void future<T>::then(Func func) && {
+	if (!valid()) {
+		throw std::future_error{ std::future_errc::no_state };
+	}
+	call_when_finished(std::move(*this), std::move(func));
+}
+
+template <class T>
+template <class Ready, class Func>
+void future<T>::call_when_finished(Ready ready, Func func) {
+	struct callback_node : sync_awaitable_node {
+		callback_node(Ready ready, Func func) : m_ready(std::move(ready)), m_func(std::move(func)) {
+			m_callback = &invoke;
+		}
+		static void invoke(sync_awaitable_node* self) noexcept {
+			auto* const node = static_cast<callback_node*>(self);
+			std::invoke(node->m_func, std::move(node->m_ready));
+			delete node;
+		}
+		static void* operator new(size_t size) { return frame_arena::allocate(size); }
+		static void operator delete(void* ptr, size_t size) { frame_arena::deallocate(ptr, size); }
+		Ready m_ready;
+		Func m_func;
+	};
+	auto& promise = ready.m_handle.promise();
+	auto* const node = new callback_node(std::move(ready), std::move(func));
+	promise.start();
+	if (!promise.chain(node)) {
+		callback_node::invoke(node);
+	}
+}
+
 template <class T>
 void future<T>::wait() const {
 	if (!valid()) {
 		throw std::future_error{ std::future_errc::no_state };
 	}
 	m_handle.promise().start();
+	if (m_handle.promise().finished()) {
+		return;
+	}
 
+	std::mutex mtx;
 	std::condition_variable cv;
 	sync_awaitable_node node;
 	node.m_cv = &cv;
+	node.m_mtx = &mtx;
 	if (m_handle.promise().chain(&node)) {
-		std::mutex mtx;
 		std::unique_lock lk(mtx);
-		cv.wait(lk, [this] {
-			return m_handle.promise().finished();
+		cv.wait(lk, [&node] {
+			return node.m_notified;
 		});
 	}
 }
@@ -241,7 +349,7 @@ template <class T>
 T future<T>::get() {
 	wait();
 	if constexpr (std::is_void_v<T>) {
-		return;
+		m_handle.promise().get(); // Rethrows.
 	}
 	else if constexpr (std::is_reference_v<T>) {
 		return m_handle.promise().get();
@@ -281,10 +389,22 @@ future<T>::future(handle_type handle) noexcept
 	m_handle.promise().add_ref();
 }
 
+template <class T>
+template <class Func>
+void shared_future<T>::then(Func func) const {
+	if (!this->valid()) {
+		throw std::future_error{ std::future_errc::no_state };
+	}
+	this->call_when_finished(*this, std::move(func));
+}
+
 template <class T>
 auto shared_future<T>::get() const -> std::conditional_t<std::is_void_v<T>, void, std::add_lvalue_reference_t<T>> {
 	this->wait();
-	if constexpr (!std::is_void_v<T>) {
+	if constexpr (std::is_void_v<T>) {
+		this->m_handle.promise().get(); // Rethrows.
+	}
+	else {
 		return this->m_handle.promise().get();
 	}
 }
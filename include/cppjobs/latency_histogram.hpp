@@ -0,0 +1,117 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+
+namespace cppjobs {
+
+/// <summary>
+/// A snapshot of a latency_histogram. Buckets are log-linear, like HDR histograms: every power of two
+/// is split into sub_buckets equal parts, so a bucket's width is at most 1/sub_buckets of its values.
+/// </summary>
+struct latency_distribution {
+	static constexpr size_t sub_bits = 3;
+	static constexpr size_t sub_buckets = size_t(1) << sub_bits;
+	/// <summary> Values of 2^max_exponent ns (about 18 minutes) and above share the last bucket. </summary>
+	static constexpr size_t max_exponent = 40;
+	static constexpr size_t num_buckets = (max_exponent - sub_bits + 1) * sub_buckets + 1;
+
+	uint64_t count = 0;
+	std::chrono::nanoseconds total{ 0 };
+	std::chrono::nanoseconds max{ 0 };
+	std::array<uint64_t, num_buckets> buckets = {};
+
+	std::chrono::nanoseconds mean() const;
+	/// <summary> The value below which the given fraction of samples fall, give or take a bucket's width. </summary>
+	std::chrono::nanoseconds percentile(double fraction) const;
+	latency_distribution& operator+=(const latency_distribution& other);
+
+	static size_t bucket_of(int64_t ns);
+	/// <summary> The largest value that falls into the bucket. </summary>
+	static int64_t bucket_upper(size_t bucket);
+};
+
+
+/// <summary>
+/// Counts durations in log-linear buckets. Threads record into their own shard without contending
+/// with each other, and the shards are merged when the histogram is read.
+/// </summary>
+class latency_histogram {
+	struct alignas(64) shard {
+		std::array<std::atomic_uint64_t, latency_distribution::num_buckets> m_buckets = {};
+		std::atomic_int64_t m_total = 0;
+		std::atomic_int64_t m_max = 0;
+	};
+
+public:
+	/// <summary> Threads beyond this many share shards, which is still correct, just slower. </summary>
+	static constexpr size_t num_shards = 16;
+
+	void record(int64_t ns) noexcept;
+	latency_distribution snapshot() const;
+	void reset();
+
+	/// <summary> Timestamp for the durations, in nanoseconds. </summary>
+	static int64_t now() noexcept;
+
+private:
+	static size_t thread_shard() noexcept;
+
+private:
+	std::unique_ptr<shard[]> m_shards = std::make_unique<shard[]>(num_shards);
+};
+
+
+struct latency_summary {
+	std::string tag;
+	/// <summary> From the coroutine being queued on the scheduler to a thread starting to run it. </summary>
+	latency_distribution queue_delay;
+	/// <summary> From resuming the coroutine to it suspending again or finishing. </summary>
+	latency_distribution execution;
+};
+
+
+/// <summary>
+/// The histograms of one scheduler or task tag, see latency_scheduler.
+/// A growing queue delay means the scheduler is overloaded, a growing execution time means the tasks got slower.
+/// </summary>
+class latency_recorder {
+	struct probe;
+
+public:
+	explicit latency_recorder(std::string tag) : m_tag(std::move(tag)) {}
+
+	/// <summary>
+	/// Returns a handle to queue in place of the given one. Resuming it records the queue delay from now,
+	/// resumes the original handle, and records how long that ran. The owner must keep the recorder alive
+	/// until the handle is resumed, and release it through release().
+	/// </summary>
+	std::coroutine_handle<> wrap(std::coroutine_handle<> handle);
+
+	const std::string& tag() const { return m_tag; }
+	latency_summary summary() const;
+	void reset();
+
+	/// <summary>
+	/// Drops the owner's reference. The handle a probe resumes may release the owner, so if the calling thread
+	/// is inside one of the recorder's probes, the reference is dropped once that probe has recorded.
+	/// </summary>
+	static void release(std::shared_ptr<latency_recorder> recorder) noexcept;
+
+private:
+	static probe run(latency_recorder* self, std::coroutine_handle<> handle, int64_t queued_at);
+
+private:
+	const std::string m_tag;
+	latency_histogram m_queue_delay;
+	latency_histogram m_execution;
+};
+
+
+} // namespace cppjobs
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace cppjobs {
+
+struct lock_stats {
+	static constexpr size_t num_buckets = 40;
+
+	std::string name;
+	uint64_t acquisitions = 0;
+	/// <summary> Acquisitions that had to wait for another holder. </summary>
+	uint64_t contended = 0;
+	std::chrono::nanoseconds total_wait{ 0 };
+	std::chrono::nanoseconds max_wait{ 0 };
+	/// <summary> Waiters that unlock walked past to find the next holder. </summary>
+	uint64_t waiters_walked = 0;
+	uint64_t unlocks = 0;
+	/// <summary> Bucket i counts the locks held for [2^i, 2^(i+1)) nanoseconds, bucket 0 counts shorter ones too. </summary>
+	std::array<uint64_t, num_buckets> hold_histogram = {};
+
+	/// <summary> Upper bound of the hold time below which the given fraction of holds fall. </summary>
+	std::chrono::nanoseconds hold_percentile(double fraction) const;
+};
+
+
+/// <summary>
+/// Statistics of all mutexes that share a name. Mutexes get one when they're constructed with a name
+/// in a build with CPPJOBS_MUTEX_PROFILING defined, otherwise profiles are never created.
+/// </summary>
+/// <remarks> Profiles live until the process exits, so that the stats of short-lived mutexes add up. </remarks>
+class lock_profile {
+public:
+	lock_profile(const lock_profile&) = delete;
+	lock_profile& operator=(const lock_profile&) = delete;
+
+	static lock_profile* get(std::string_view name);
+
+	void acquired(int64_t wait_ns, bool contended);
+	void released(int64_t hold_ns, uint64_t waiters_walked);
+	lock_stats stats() const;
+	void reset();
+
+	/// <summary> Timestamp for the mutexes, in nanoseconds. </summary>
+	static int64_t now();
+
+private:
+	explicit lock_profile(std::string name) : m_name(std::move(name)) {}
+
+private:
+	std::string m_name;
+	std::atomic_uint64_t m_acquisitions = 0;
+	std::atomic_uint64_t m_contended = 0;
+	std::atomic_int64_t m_total_wait = 0;
+	std::atomic_int64_t m_max_wait = 0;
+	std::atomic_uint64_t m_waiters_walked = 0;
+	std::atomic_uint64_t m_unlocks = 0;
+	std::array<std::atomic_uint64_t, lock_stats::num_buckets> m_hold_histogram = {};
+};
+
+
+/// <summary>
+/// Reports which named mutexes are the most contended.
+/// Name a mutex or shared_mutex through its constructor, and build everything with CPPJOBS_MUTEX_PROFILING
+/// defined (the ENABLE_MUTEX_PROFILING CMake option). Mutexes that share a name are reported together,
+/// e.g. the shards of a table. Without the define, mutexes have no profiling code and nothing is reported.
+/// </summary>
+class lock_profiler {
+public:
+#ifdef CPPJOBS_MUTEX_PROFILING
+	static constexpr bool enabled = true;
+#else
+	static constexpr bool enabled = false;
+#endif
+
+	/// <summary> Stats of every named mutex, the most waited for first. </summary>
+	static std::vector<lock_stats> snapshot();
+	/// <summary> The count locks with the most total wait time. </summary>
+	static std::vector<lock_stats> top_contended(size_t count = 10);
+	/// <summary> Prints the count most contended locks as a table. </summary>
+	static void report(std::ostream& out, size_t count = 10);
+	static void reset();
+};
+
+
+} // namespace cppjobs
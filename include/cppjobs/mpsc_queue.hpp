@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+
+
+namespace cppjobs {
+
+struct mpsc_node {
+	std::atomic<mpsc_node*> m_next = nullptr;
+};
+
+
+/// <summary>
+/// Intrusive multi-producer single-consumer queue (Vyukov's node based design).
+/// Pushing is wait-free: one exchange and one store. Only a single thread may pop at a time.
+/// </summary>
+/// <typeparam name="Node"> Must derive from mpsc_node. The queue does not own the nodes. </typeparam>
+template <class Node>
+class mpsc_queue {
+public:
+	mpsc_queue() = default;
+	mpsc_queue(const mpsc_queue&) = delete;
+	mpsc_queue& operator=(const mpsc_queue&) = delete;
+
+	void push(Node* node);
+	/// <summary> Returns nullptr when empty, or when a producer is in the middle of a push. </summary>
+	/// <remarks> Consumer context only. </remarks>
+	Node* pop();
+	/// <summary> False as long as there are nodes to pop, including ones that are still being pushed. </summary>
+	/// <remarks> Consumer context only. </remarks>
+	bool empty() const;
+	/// <summary> Safe to call from any thread, but only exact when no pop() is running at the same time. </summary>
+	bool approx_empty() const;
+
+private:
+	void push_node(mpsc_node* node);
+
+private:
+	mpsc_node m_stub;
+	std::atomic<mpsc_node*> m_head = &m_stub;
+	mpsc_node* m_tail = &m_stub;
+};
+
+
+template <class Node>
+void mpsc_queue<Node>::push(Node* node) {
+	push_node(static_cast<mpsc_node*>(node));
+}
+
+template <class Node>
+void mpsc_queue<Node>::push_node(mpsc_node* node) {
+	node->m_next.store(nullptr, std::memory_order_relaxed);
+	mpsc_node* previous = m_head.exchange(node);
+	// Between the exchange and this store the list is temporarily broken, pop() sees it as empty.
+	previous->m_next.store(node, std::memory_order_release);
+}
+
+template <class Node>
+Node* mpsc_queue<Node>::pop() {
+	mpsc_node* tail = m_tail;
+	mpsc_node* next = tail->m_next.load(std::memory_order_acquire);
+	if (tail == &m_stub) {
+		if (next == nullptr) {
+			return nullptr;
+		}
+		m_tail = next;
+		tail = next;
+		next = next->m_next.load(std::memory_order_acquire);
+	}
+	if (next != nullptr) {
+		m_tail = next;
+		return static_cast<Node*>(tail);
+	}
+	if (tail != m_head.load()) {
+		return nullptr;
+	}
+	// Tail is the last node, put the stub behind it so that it can be unlinked.
+	push_node(&m_stub);
+	next = tail->m_next.load(std::memory_order_acquire);
+	if (next != nullptr) {
+		m_tail = next;
+		return static_cast<Node*>(tail);
+	}
+	return nullptr;
+}
+
+template <class Node>
+bool mpsc_queue<Node>::empty() const {
+	return m_tail == &m_stub && m_stub.m_next.load() == nullptr && m_head.load() == &m_stub;
+}
+
+template <class Node>
+bool mpsc_queue<Node>::approx_empty() const {
+	return m_head.load() == &m_stub;
+}
+
+
+} // namespace cppjobs
@@ -1,12 +1,18 @@
 #pragma once
 
 #include "awaitable_node.hpp"
+#include "coroutine_registry.hpp"
 
 #include <atomic>
+#include <cstdint>
+#include <limits>
+#include <string_view>
 
 
 namespace cppjobs {
 
+class lock_profile;
+
 
 class mutex {
 	template <class Mutex>
@@ -34,10 +40,19 @@ class mutex {
 		bool await_suspend(std::coroutine_handle<Promise> waiting);
 		token await_resume() const;
 		mutex* const m_mutex;
+#ifdef CPPJOBS_MUTEX_PROFILING
+		bool m_contended = false;
+		int64_t m_wait_start = 0;
+#endif
+#ifdef CPPJOBS_COROUTINE_REGISTRY
+		coroutine_record* m_record = nullptr;
+#endif
 	};
 
 public:
 	mutex() = default;
+	/// <summary> Names the mutex for lock_profiler. The name is ignored unless CPPJOBS_MUTEX_PROFILING is defined. </summary>
+	explicit mutex(std::string_view name);
 	mutex(const mutex&) = delete;
 	mutex(mutex&&) = delete;
 	mutex& operator=(const mutex&) = delete;
@@ -47,12 +62,36 @@ public:
 	bool try_lock();
 	void unlock();
 	bool _is_locked() const;
+#ifdef CPPJOBS_COROUTINE_REGISTRY
+	/// <summary> The id of the coroutine holding the mutex, zero if it's free or locked by try_lock. </summary>
+	uint64_t _owner() const { return m_owner.load(std::memory_order_relaxed); }
+#endif
+
+private:
+	bool try_acquire();
+	/// <summary> Ends the m_waiting linked list while the mutex is locked, in place of the holder. </summary>
+	static awaitable_node* locked_tag() { return reinterpret_cast<awaitable_node*>(std::numeric_limits<uintptr_t>::max()); }
+#ifdef CPPJOBS_MUTEX_PROFILING
+	void profile_acquired(int64_t wait_start, bool contended);
+	static int64_t profile_now();
+#endif
 
 private:
+	/// <summary> Nullptr if free, otherwise the waiters, the last one queued first, followed by locked_tag(). </summary>
+	/// <remarks>
+	/// The holder's node is never part of the list. Once its coroutine continues, the node is freed
+	/// and its address may come back as a new waiter, which unlock would mistake for the holder.
+	/// </remarks>
 	std::atomic<awaitable_node*> m_waiting = nullptr;
-	/// <summary> Always a dangling pointer. The last element of the m_waiting linked list. </summary>
+#ifdef CPPJOBS_MUTEX_PROFILING
+	lock_profile* m_profile = nullptr;
+	/// <summary> When the current holder got the lock. </summary>
 	/// <remarks> Modify this variable only from holder context! </remarks>
-	awaitable_node* m_holder = nullptr;
+	int64_t m_locked_at = 0;
+#endif
+#ifdef CPPJOBS_COROUTINE_REGISTRY
+	std::atomic_uint64_t m_owner = 0;
+#endif
 };
 
 
@@ -72,20 +111,38 @@ private:
 
 template <class Promise>
 bool mutex::awaitable::await_suspend(std::coroutine_handle<Promise> waiting) {
-	bool success;
-	awaitable_node* previous_in_line;
-	do {
-		previous_in_line = m_mutex->m_waiting;
+#ifdef CPPJOBS_MUTEX_PROFILING
+	// Before queuing, the unlocking thread may resume and destroy this node any time after.
+	if (m_mutex->m_profile != nullptr) {
+		m_contended = true;
+		m_wait_start = profile_now();
+	}
+#endif
+#ifdef CPPJOBS_COROUTINE_REGISTRY
+	m_record = coroutine_record::of(waiting);
+	if (m_record != nullptr) {
+		// If it changes hands before this one is queued, the edge points to the previous holder until the next hand-off.
+		m_record->waits_on(await_kind::mutex, m_mutex, m_mutex->_owner());
+	}
+#endif
+	awaitable_node* previous_in_line = m_mutex->m_waiting.load();
+	while (true) {
+		if (previous_in_line == nullptr) {
+			// Free, so lock it like try_lock does, without queuing this node.
+			if (m_mutex->m_waiting.compare_exchange_weak(previous_in_line, locked_tag())) {
+#ifdef CPPJOBS_MUTEX_PROFILING
+				m_contended = false;
+#endif
+				return false;
+			}
+			continue;
+		}
 		m_next = previous_in_line;
 		set_waiting(waiting);
-		success = m_mutex->m_waiting.compare_exchange_weak(previous_in_line, const_cast<awaitable*>(this));
-	} while (!success);
-
-	if (previous_in_line == nullptr) {
-		m_mutex->m_holder = const_cast<awaitable*>(this);
+		if (m_mutex->m_waiting.compare_exchange_weak(previous_in_line, const_cast<awaitable*>(this))) {
+			return true;
+		}
 	}
-
-	return previous_in_line != nullptr;
 }
 
 } // namespace cppjobs
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "future.hpp"
+#include "scheduler.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <ranges>
+#include <vector>
+
+
+namespace cppjobs {
+
+namespace impl {
+
+	// Lazy binary splitting: the range is halved only when the scheduler wants more work,
+	// otherwise it's processed serially, grain elements between two checks.
+	template <class Iter, class Body>
+	future<void> parallel_for_split(std::shared_ptr<scheduler> sched, Iter first, Iter last, const Body* body, size_t grain) {
+		using diff_t = std::iter_difference_t<Iter>;
+		std::vector<future<void>> children;
+		std::exception_ptr error;
+		try {
+			while (first != last) {
+				while (last - first > diff_t(grain) && sched->needs_work()) {
+					const Iter middle = first + (last - first) / 2;
+					children.push_back(sched->schedule(parallel_for_split<Iter, Body>, sched, middle, last, body, grain));
+					children.back().start();
+					last = middle;
+				}
+				const Iter chunk_last = first + std::min(last - first, diff_t(grain));
+				for (; first != chunk_last; ++first) {
+					std::invoke(*body, *first);
+				}
+			}
+		}
+		catch (...) {
+			error = std::current_exception();
+		}
+		// Children refer to the body, which the caller's frame owns, they must finish before we return.
+		for (auto& child : children) {
+			try {
+				co_await child;
+			}
+			catch (...) {
+				if (!error) {
+					error = std::current_exception();
+				}
+			}
+		}
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+
+	template <class Iter, class T, class Reduce, class Transform>
+	future<T> parallel_reduce_split(std::shared_ptr<scheduler> sched, Iter first, Iter last, T identity, const Reduce* reduce, const Transform* transform, size_t grain) {
+		using diff_t = std::iter_difference_t<Iter>;
+		std::vector<future<T>> children;
+		std::exception_ptr error;
+		T result = identity;
+		try {
+			while (first != last) {
+				while (last - first > diff_t(grain) && sched->needs_work()) {
+					const Iter middle = first + (last - first) / 2;
+					children.push_back(sched->schedule(parallel_reduce_split<Iter, T, Reduce, Transform>, sched, middle, last, identity, reduce, transform, grain));
+					children.back().start();
+					last = middle;
+				}
+				const Iter chunk_last = first + std::min(last - first, diff_t(grain));
+				for (; first != chunk_last; ++first) {
+					result = std::invoke(*reduce, std::move(result), std::invoke(*transform, *first));
+				}
+			}
+		}
+		catch (...) {
+			error = std::current_exception();
+		}
+		// The last child holds the part right after ours, so the order of the reduction is kept.
+		for (auto it = children.rbegin(); it != children.rend(); ++it) {
+			try {
+				T part = co_await *it;
+				if (!error) {
+					result = std::invoke(*reduce, std::move(result), std::move(part));
+				}
+			}
+			catch (...) {
+				if (!error) {
+					error = std::current_exception();
+				}
+			}
+		}
+		if (error) {
+			std::rethrow_exception(error);
+		}
+		co_return result;
+	}
+
+	template <class View, class Body>
+	future<void> parallel_for_root(std::shared_ptr<scheduler> sched, View view, Body body, size_t grain) {
+		const auto first = std::ranges::begin(view);
+		co_await parallel_for_split(sched, first, first + std::ranges::distance(view), &body, grain);
+	}
+
+	template <class View, class T, class Reduce, class Transform>
+	future<T> parallel_reduce_root(std::shared_ptr<scheduler> sched, View view, T identity, Reduce reduce, Transform transform, size_t grain) {
+		const auto first = std::ranges::begin(view);
+		co_return co_await parallel_reduce_split(sched, first, first + std::ranges::distance(view), std::move(identity), &reduce, &transform, grain);
+	}
+
+} // namespace impl
+
+
+/// <summary>
+/// Calls body on each element of the range in parallel on the scheduler.
+/// Instead of a coroutine per element, the range is split in half, recursively, only when
+/// the scheduler reports idle resources. Otherwise elements are processed serially in runs of grain.
+/// </summary>
+/// <remarks>
+/// The range is referenced if it's an lvalue, so it must outlive the returned future.
+/// Exceptions from body are propagated by the future once all running parts have stopped.
+/// </remarks>
+template <std::ranges::random_access_range Range, class Body>
+	requires std::ranges::sized_range<Range>
+future<void> parallel_for(std::shared_ptr<scheduler> sched, Range&& range, Body body, size_t grain = 1) {
+	auto view = std::views::all(std::forward<Range>(range));
+	return sched->schedule(impl::parallel_for_root<decltype(view), Body>, sched, std::move(view), std::move(body), std::max(grain, size_t(1)));
+}
+
+
+/// <summary>
+/// Reduces transform(element) over the range with an associative reduce operation, in parallel.
+/// Splits the range the same way as parallel_for. The order of the operands is kept,
+/// so reduce need not be commutative. Every part starts from identity, which must be neutral for reduce.
+/// </summary>
+template <std::ranges::random_access_range Range, class T, class Reduce, class Transform = std::identity>
+	requires std::ranges::sized_range<Range>
+future<T> parallel_reduce(std::shared_ptr<scheduler> sched, Range&& range, T identity, Reduce reduce, Transform transform = {}, size_t grain = 1) {
+	auto view = std::views::all(std::forward<Range>(range));
+	return sched->schedule(impl::parallel_reduce_root<decltype(view), T, Reduce, Transform>, sched, std::move(view), std::move(identity), std::move(reduce), std::move(transform), std::max(grain, size_t(1)));
+}
+
+
+} // namespace cppjobs
@@ -0,0 +1,205 @@
+#pragma once
+
+#include "future.hpp"
+#include "scheduler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+
+namespace cppjobs {
+
+enum class stage_mode {
+	serial_in_order, ///< One item at a time, in the order the source produced them.
+	serial_out_of_order, ///< One item at a time, in any order.
+	parallel, ///< Any number of items at a time.
+};
+
+
+template <class Func>
+struct pipeline_stage {
+	stage_mode m_mode;
+	Func m_func;
+};
+
+
+/// <summary> A pipeline stage that calls func on each item, and passes the result on to the next stage. </summary>
+template <class Func>
+pipeline_stage<Func> stage(stage_mode mode, Func func) {
+	return { mode, std::move(func) };
+}
+
+
+/// <summary> The parts of pipeline that don't depend on the stages: serial stage gates and error handling. </summary>
+class pipeline_base {
+public:
+	pipeline_base(const pipeline_base&) = delete;
+	pipeline_base& operator=(const pipeline_base&) = delete;
+
+protected:
+	struct gate;
+	struct gate_awaitable {
+		bool await_ready() const noexcept { return m_gate == nullptr; }
+		bool await_suspend(std::coroutine_handle<> waiting) const;
+		void await_resume() const noexcept {}
+		gate* m_gate;
+		size_t m_sequence;
+	};
+
+	/// <summary> Stage 0 is the source, which is always serial. </summary>
+	explicit pipeline_base(std::vector<stage_mode> modes);
+	~pipeline_base();
+
+	gate_awaitable enter(size_t stage, size_t sequence);
+	void leave(size_t stage);
+
+	void start(std::shared_ptr<scheduler_base> sched);
+	void finish();
+	void fail(std::exception_ptr error);
+	bool failed() const { return m_failed.load(std::memory_order_relaxed); }
+
+protected:
+	/// <summary> Sequence number of the next item, only touched by the holder of the source's gate. </summary>
+	size_t m_next_sequence = 0;
+	/// <summary> Source has returned nullopt, only touched by the holder of the source's gate. </summary>
+	bool m_exhausted = false;
+
+private:
+	std::vector<std::unique_ptr<gate>> m_gates;
+	std::shared_ptr<scheduler_base> m_scheduler;
+	std::atomic_bool m_running = false;
+	std::atomic_bool m_failed = false;
+	std::mutex m_error_mtx;
+	std::exception_ptr m_error;
+};
+
+
+/// <summary>
+/// Streams items from a source through a sequence of stages. Serial stages process one item at a time,
+/// in the source's order if they are in-order. Parallel stages process any number of items at once.
+/// At most max_tokens items are in flight, so memory stays bounded however fast the source is.
+/// Each token is a coroutine that carries one item at a time through all stages, and waits at serial stages
+/// for its turn without blocking its thread.
+/// </summary>
+/// <remarks>
+/// The source is called serially, and returns std::optional; nullopt ends the stream.
+/// Every stage gets the previous stage's result as an rvalue. The result of the last stage is discarded.
+/// If a stage throws, no more items are read, the items in flight skip the remaining stages,
+/// and the run rethrows the first exception. The pipeline must outlive its runs, which must not overlap.
+/// </remarks>
+template <class Source, class... Funcs>
+class pipeline : public pipeline_base {
+	static_assert(sizeof...(Funcs) > 0, "a pipeline needs at least one stage after the source");
+
+	// The input of every stage, as optionals. The last stage's output is not stored.
+	template <class In, class... Rest>
+	struct stage_values {
+		using type = std::tuple<>;
+	};
+	template <class In, class Func, class... Rest>
+	struct stage_values<In, Func, Rest...> {
+		using type = decltype(std::tuple_cat(std::declval<std::tuple<std::optional<In>>>(),
+											 std::declval<typename stage_values<std::invoke_result_t<Func&, In&&>, Rest...>::type>()));
+	};
+	using item_t = typename std::invoke_result_t<Source&>::value_type;
+	using values_t = typename stage_values<item_t, Funcs...>::type;
+
+public:
+	explicit pipeline(Source source, pipeline_stage<Funcs>... stages)
+		: pipeline_base({ stage_mode::serial_out_of_order, stages.m_mode... }),
+		  m_source(std::move(source)),
+		  m_funcs(std::move(stages.m_func)...) {}
+
+	/// <summary> Runs the pipeline until the source is exhausted, with at most max_tokens items in flight. </summary>
+	future<void> run(std::shared_ptr<scheduler> sched, size_t max_tokens);
+
+private:
+	template <size_t... Indices>
+	future<void> carry_tokens(std::index_sequence<Indices...>);
+	template <size_t Index>
+	void process(values_t& values);
+
+private:
+	Source m_source;
+	std::tuple<Funcs...> m_funcs;
+};
+
+
+template <class Source, class... Funcs>
+future<void> pipeline<Source, Funcs...>::run(std::shared_ptr<scheduler> sched, size_t max_tokens) {
+	start(sched);
+	std::vector<future<void>> tokens;
+	for (size_t i = 0; i < std::max(max_tokens, size_t(1)); ++i) {
+		tokens.push_back(sched->schedule([](pipeline* self) { return self->carry_tokens(std::index_sequence_for<Funcs...>{}); }, this));
+		tokens.back().start();
+	}
+	for (auto& token : tokens) {
+		co_await token;
+	}
+	finish();
+}
+
+
+template <class Source, class... Funcs>
+template <size_t... Indices>
+future<void> pipeline<Source, Funcs...>::carry_tokens(std::index_sequence<Indices...>) {
+	values_t values;
+	while (true) {
+		co_await enter(0, 0);
+		size_t sequence = 0;
+		if (!failed() && !m_exhausted) {
+			try {
+				std::get<0>(values) = m_source();
+			}
+			catch (...) {
+				fail(std::current_exception());
+			}
+			m_exhausted = !std::get<0>(values).has_value();
+		}
+		const bool has_item = std::get<0>(values).has_value();
+		if (has_item) {
+			sequence = m_next_sequence++;
+		}
+		leave(0);
+		if (!has_item) {
+			co_return;
+		}
+		// Stage Index is behind gate Index + 1, the source being gate 0.
+		((co_await enter(Indices + 1, sequence), process<Indices>(values), leave(Indices + 1)), ...);
+	}
+}
+
+
+template <class Source, class... Funcs>
+template <size_t Index>
+void pipeline<Source, Funcs...>::process(values_t& values) {
+	auto& input = std::get<Index>(values);
+	// After a failure, the item still passes every gate to let the ones behind it through, but isn't processed.
+	if (input && !failed()) {
+		try {
+			auto& func = std::get<Index>(m_funcs);
+			if constexpr (Index + 1 < sizeof...(Funcs)) {
+				std::get<Index + 1>(values) = std::invoke(func, std::move(*input));
+			}
+			else {
+				std::invoke(func, std::move(*input));
+			}
+		}
+		catch (...) {
+			fail(std::current_exception());
+		}
+	}
+	input.reset();
+}
+
+
+} // namespace cppjobs
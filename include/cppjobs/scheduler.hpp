@@ -12,7 +12,7 @@ public:
 	template <class Func, class... Args>
 	auto schedule(Func func, Args&&... args);
 	
-private:
+protected:
 	template <class Func, class... Args>
 	static awaitable auto launch(Func func, Args&&... args) requires awaitable<std::invoke_result_t<Func, Args...>> {
 		return func(std::forward<Args>(args)...);
@@ -1,15 +1,63 @@
 #pragma once
 
-#include <memory>
+#include "coroutine_registry.hpp"
+#include "frame_accounting.hpp"
+#include "frame_arena.hpp"
+
+#include <chrono>
 #include <coroutine>
+#include <cstdint>
+#include <memory>
+#include <span>
 
 
 namespace cppjobs {
 
+/// <summary>
+/// Snapshot of a scheduler's counters and gauges. Counters only grow, rates are the difference of two snapshots.
+/// Schedulers that don't keep a metric leave it zero.
+/// </summary>
+struct scheduler_metrics {
+	/// <summary> Handles queued for resumption. </summary>
+	uint64_t queued = 0;
+	/// <summary> Handles a worker queued onto its own queue. </summary>
+	uint64_t queued_local = 0;
+	/// <summary> Handles that went through the injection queues, typically queued from outside the pool. </summary>
+	uint64_t queued_injected = 0;
+	uint64_t resumed = 0;
+	/// <summary> Handles a worker took from another worker. </summary>
+	uint64_t stolen = 0;
+	/// <summary> Time spent running or looking for work, and time spent waiting for work, summed over the workers. </summary>
+	std::chrono::nanoseconds busy{ 0 };
+	std::chrono::nanoseconds idle{ 0 };
+	/// <summary> Handles waiting in the queues at the moment. </summary>
+	size_t queue_length = 0;
+	/// <summary> The longest any single queue has ever been. </summary>
+	size_t max_queue_length = 0;
+	size_t workers = 0;
+};
+
+
 class scheduler_base : public std::enable_shared_from_this<scheduler_base> {
 public:
 	virtual ~scheduler_base() {}
 	virtual void queue_for_resume(std::coroutine_handle<> handle) = 0;
+	/// <summary> Queues many handles at once. Schedulers override it to hand over the whole batch in one go. </summary>
+	virtual void queue_for_resume_batch(std::span<const std::coroutine_handle<>> handles) {
+		for (auto handle : handles) {
+			queue_for_resume(handle);
+		}
+	}
+	/// <summary>
+	/// True if queuing more work from the calling thread would put idle resources to use.
+	/// Parallel algorithms split their ranges only while this says so. Serial schedulers never ask for more.
+	/// </summary>
+	virtual bool needs_work() const { return false; }
+	/// <summary>
+	/// Reads the scheduler's metrics without locks. Meant to be scraped periodically, it doesn't slow the workers down.
+	/// The values are read one by one, so they may be slightly out of sync with each other.
+	/// </summary>
+	virtual scheduler_metrics metrics() const { return {}; }
 
 	inline static thread_local std::shared_ptr<scheduler_base> tls_scheduler = nullptr;
 
@@ -17,7 +65,18 @@ public:
 
 struct schedulable_promise {
 	schedulable_promise() : m_scheduler(scheduler_base::tls_scheduler) {}
+#ifdef CPPJOBS_FRAME_ACCOUNTING
+	// The default argument is evaluated in the coroutine, which identifies the coroutine function.
+	static void* operator new(size_t size, std::source_location location = std::source_location::current()) { return frame_accounting::allocate(size, location); }
+	static void operator delete(void* ptr, size_t size) { frame_accounting::deallocate(ptr, size); }
+#else
+	static void* operator new(size_t size) { return frame_arena::allocate(size); }
+	static void operator delete(void* ptr, size_t size) { frame_arena::deallocate(ptr, size); }
+#endif
 	std::shared_ptr<scheduler_base> m_scheduler = nullptr;
+#ifdef CPPJOBS_COROUTINE_REGISTRY
+	coroutine_record m_record;
+#endif
 };
 
 } // namespace cppjobs
\ No newline at end of file
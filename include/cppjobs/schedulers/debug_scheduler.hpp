@@ -10,6 +10,8 @@
 template <class Scheduler>
 class debug_scheduler : public Scheduler {
 public:
+	using Scheduler::Scheduler;
+
 	size_t resume_count() const {
 		return m_resume_count;
 	}
@@ -18,6 +20,10 @@ protected:
 		++m_resume_count;
 		Scheduler::queue_for_resume(handle);
 	}
+	void queue_for_resume_batch(std::span<const std::coroutine_handle<>> handles) override {
+		m_resume_count += handles.size();
+		Scheduler::queue_for_resume_batch(handles);
+	}
 private:
 	std::atomic_size_t m_resume_count = 0;
 	
@@ -0,0 +1,173 @@
+#pragma once
+
+#include "../latency_histogram.hpp"
+#include "../scheduler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+namespace cppjobs {
+
+namespace impl {
+
+/// <summary> The recorders of a latency_scheduler. </summary>
+/// <remarks>
+/// It's a base class so that the recorders outlive the measured scheduler, whose destructor may wait for
+/// its threads to finish their probes. A probe on the destroying thread itself releases them when it's done.
+/// </remarks>
+struct latency_recorders {
+	~latency_recorders() {
+		latency_recorder::release(std::move(m_untagged));
+		for (auto& [tag, recorder] : m_tags) {
+			latency_recorder::release(std::move(recorder));
+		}
+	}
+
+	std::shared_ptr<latency_recorder> m_untagged = std::make_shared<latency_recorder>("");
+	mutable std::mutex m_tags_mtx;
+	std::map<std::string, std::shared_ptr<latency_recorder>, std::less<>> m_tags;
+};
+
+} // namespace impl
+
+
+/// <summary>
+/// Wraps a scheduler to keep histograms of how long coroutines wait in its queue before a thread runs them,
+/// and how long they run before suspending again. When the tail latency of the tasks spikes, the former
+/// growing means the scheduler is overloaded, the latter growing means the tasks themselves got slower.
+/// </summary>
+/// <remarks>
+/// Each queued handle is wrapped into a small probe coroutine, which times it when the scheduler resumes it.
+/// The probes point to the recorders without owning them, the scheduler keeps them until the probes are done.
+/// Views created by tagged() keep separate histograms for the coroutines scheduled through them.
+/// </remarks>
+/// <typeparam name="Scheduler"> The scheduler to measure. </typeparam>
+template <class Scheduler>
+class latency_scheduler : private impl::latency_recorders, public Scheduler {
+	class tag_view;
+
+public:
+	using Scheduler::Scheduler;
+
+	/// <summary>
+	/// A scheduler that runs coroutines on this one, and records their latencies under the tag.
+	/// Views with the same tag share histograms.
+	/// </summary>
+	std::shared_ptr<scheduler> tagged(std::string_view tag);
+
+	/// <summary> Latencies of all coroutines on the scheduler, tagged or not. </summary>
+	latency_summary latencies() const;
+	/// <summary> Latencies of each tag, untagged coroutines under the empty tag. </summary>
+	std::vector<latency_summary> latencies_by_tag() const;
+	void reset_latencies();
+
+protected:
+	void queue_for_resume(std::coroutine_handle<> handle) override {
+		Scheduler::queue_for_resume(m_untagged->wrap(handle));
+	}
+	void queue_for_resume_batch(std::span<const std::coroutine_handle<>> handles) override {
+		queue_wrapped(*m_untagged, handles);
+	}
+
+private:
+	void queue_wrapped(latency_recorder& recorder, std::span<const std::coroutine_handle<>> handles);
+};
+
+
+template <class Scheduler>
+class latency_scheduler<Scheduler>::tag_view : public scheduler {
+public:
+	tag_view(std::shared_ptr<latency_scheduler> owner, latency_recorder& recorder)
+		: m_owner(std::move(owner)), m_recorder(&recorder) {}
+
+	bool needs_work() const override { return m_owner->needs_work(); }
+	scheduler_metrics metrics() const override { return m_owner->metrics(); }
+
+protected:
+	void queue_for_resume(std::coroutine_handle<> handle) override {
+		m_owner->Scheduler::queue_for_resume(m_recorder->wrap(handle));
+	}
+	void queue_for_resume_batch(std::span<const std::coroutine_handle<>> handles) override {
+		m_owner->queue_wrapped(*m_recorder, handles);
+	}
+
+private:
+	std::shared_ptr<latency_scheduler> m_owner;
+	/// <summary> Owned by m_owner. </summary>
+	latency_recorder* m_recorder;
+};
+
+
+template <class Scheduler>
+std::shared_ptr<scheduler> latency_scheduler<Scheduler>::tagged(std::string_view tag) {
+	latency_recorder* recorder;
+	{
+		std::lock_guard lk(m_tags_mtx);
+		auto it = m_tags.find(tag);
+		if (it == m_tags.end()) {
+			it = m_tags.emplace(std::string(tag), std::make_shared<latency_recorder>(std::string(tag))).first;
+		}
+		recorder = it->second.get();
+	}
+	auto self = std::static_pointer_cast<latency_scheduler>(this->shared_from_this());
+	return std::make_shared<tag_view>(std::move(self), *recorder);
+}
+
+
+template <class Scheduler>
+latency_summary latency_scheduler<Scheduler>::latencies() const {
+	latency_summary total = m_untagged->summary();
+	std::lock_guard lk(m_tags_mtx);
+	for (const auto& [tag, recorder] : m_tags) {
+		const latency_summary item = recorder->summary();
+		total.queue_delay += item.queue_delay;
+		total.execution += item.execution;
+	}
+	return total;
+}
+
+
+template <class Scheduler>
+std::vector<latency_summary> latency_scheduler<Scheduler>::latencies_by_tag() const {
+	std::vector<latency_summary> result;
+	result.push_back(m_untagged->summary());
+	std::lock_guard lk(m_tags_mtx);
+	for (const auto& [tag, recorder] : m_tags) {
+		result.push_back(recorder->summary());
+	}
+	return result;
+}
+
+
+template <class Scheduler>
+void latency_scheduler<Scheduler>::reset_latencies() {
+	m_untagged->reset();
+	std::lock_guard lk(m_tags_mtx);
+	for (const auto& [tag, recorder] : m_tags) {
+		recorder->reset();
+	}
+}
+
+
+template <class Scheduler>
+void latency_scheduler<Scheduler>::queue_wrapped(latency_recorder& recorder, std::span<const std::coroutine_handle<>> handles) {
+	std::array<std::coroutine_handle<>, 64> wrapped;
+	while (!handles.empty()) {
+		const size_t count = std::min(handles.size(), wrapped.size());
+		for (size_t i = 0; i < count; ++i) {
+			wrapped[i] = recorder.wrap(handles[i]);
+		}
+		Scheduler::queue_for_resume_batch(std::span<const std::coroutine_handle<>>(wrapped.data(), count));
+		handles = handles.subspan(count);
+	}
+}
+
+
+} // namespace cppjobs
@@ -10,7 +10,7 @@ protected:
 	void queue_for_resume(std::coroutine_handle<> handle) override {
 		m_handles.push(handle);
 		while (!m_handles.empty()) {
-			m_handles.front().resume();
+			tracer::resume(m_handles.front());
 			m_handles.pop();
 		}
 	}
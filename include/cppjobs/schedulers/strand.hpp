@@ -0,0 +1,60 @@
+#pragma once
+
+#include "../mpsc_queue.hpp"
+#include "../scheduler.hpp"
+
+#include <atomic>
+#include <memory>
+
+
+namespace cppjobs {
+
+/// <summary>
+/// Serializes the coroutines resumed through it on top of another scheduler.
+/// Handles run one at a time in FIFO order, but no lock is held: whoever finds the strand
+/// idle submits a single drain task to the underlying scheduler, and that task resumes
+/// queued handles in batches on whichever worker picked it up.
+/// The queue's nodes come from the frame_arena, like coroutine frames, so queuing a handle costs no heap allocation on pool threads.
+/// </summary>
+/// <remarks> Create via std::make_shared, like other schedulers. </remarks>
+class strand : public scheduler {
+public:
+	explicit strand(std::shared_ptr<scheduler_base> underlying, size_t batch_size = 64);
+	strand(const strand&) = delete;
+	strand& operator=(const strand&) = delete;
+	~strand();
+
+	const std::shared_ptr<scheduler_base>& underlying() const { return m_underlying; }
+	/// <summary> Queued and resumed handles, and how many are waiting. The underlying scheduler has the rest. </summary>
+	scheduler_metrics metrics() const override;
+
+protected:
+	void queue_for_resume(std::coroutine_handle<> handle) override;
+
+private:
+	struct job : mpsc_node {
+		std::coroutine_handle<> m_handle;
+	};
+	struct drain_task;
+	struct drain_awaitable;
+
+	static job* make_job(std::coroutine_handle<> handle);
+	static void destroy_job(job* destroyed) noexcept;
+	drain_task drain();
+
+private:
+	std::shared_ptr<scheduler_base> m_underlying;
+	const size_t m_batch_size;
+	mpsc_queue<job> m_queue;
+	std::atomic_bool m_running = false;
+	/// <summary> Keeps the strand alive while a drain is pending or in progress. </summary>
+	/// <remarks> Modify this variable only from the context that owns m_running! </remarks>
+	std::shared_ptr<scheduler_base> m_self;
+	std::coroutine_handle<> m_drainer;
+	std::atomic_uint64_t m_queued = 0;
+	/// <summary> Only the drainer writes it. </summary>
+	std::atomic_uint64_t m_resumed = 0;
+};
+
+
+} // namespace cppjobs
@@ -0,0 +1,236 @@
+#pragma once
+
+#include "../scheduler.hpp"
+#include "../thread_policy.hpp"
+#include "../topology.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <ranges>
+#include <span>
+#include <thread>
+#include <vector>
+
+
+namespace cppjobs {
+
+enum class thread_pinning {
+	none, ///< Let the OS place the workers.
+	node, ///< Restrict each worker to the CPUs of its NUMA node.
+	cpu, ///< Bind each worker to a single CPU, round-robin within its node.
+};
+
+
+/// <summary>
+/// What a worker does when it runs out of work: first it spins, polling for new work, then it polls
+/// while yielding its CPU to other threads, and finally it parks on a futex until woken.
+/// Spinning trades CPU time (and power) for wake-up latency; only parking costs a syscall to wake.
+/// </summary>
+struct idle_policy {
+	std::chrono::nanoseconds spin = std::chrono::microseconds(20);
+	std::chrono::nanoseconds yield = std::chrono::microseconds(50);
+
+	/// <summary> Keeps workers hot through short gaps between tasks. </summary>
+	static idle_policy low_latency() { return { std::chrono::microseconds(200), std::chrono::milliseconds(2) }; }
+	/// <summary> Parks right away, never burns CPU while idle. </summary>
+	static idle_policy low_power() { return { std::chrono::nanoseconds(0), std::chrono::nanoseconds(0) }; }
+};
+
+
+struct thread_pool_options {
+	/// <summary> Number of worker threads. Zero means one per CPU the pool may use. </summary>
+	size_t num_threads = 0;
+	/// <summary>
+	/// The CPUs the pool may use. Empty means all CPUs in the topology.
+	/// Give pools disjoint sets to reserve cores, e.g. for an I/O pool and a compute pool.
+	/// </summary>
+	std::vector<size_t> cpus;
+	thread_pinning pinning = thread_pinning::node;
+	/// <summary> Scheduling policy and niceness applied to every worker thread. </summary>
+	thread_policy policy;
+	/// <summary>
+	/// Upper bound on the number of threads, including the ones stuck in a blocking_region.
+	/// Zero means num_threads, that is, blocked workers are not compensated.
+	/// </summary>
+	size_t max_threads = 0;
+	/// <summary> Threads beyond num_threads exit after idling for this long. </summary>
+	std::chrono::milliseconds idle_timeout = std::chrono::seconds(10);
+	/// <summary> How workers wait for work. </summary>
+	idle_policy idle;
+	/// <summary>
+	/// How many times in a row a worker may run the coroutine it woke last before taking the oldest item
+	/// of its queue. Zero turns the LIFO slot off, and all work is taken in FIFO order.
+	/// </summary>
+	size_t lifo_limit = 16;
+	/// <summary> Machine layout to distribute the workers over. Empty means system_topology(). </summary>
+	std::vector<numa_node> topology;
+};
+
+
+/// <summary>
+/// Work stealing thread pool that is aware of the NUMA layout.
+/// Workers are spread over the NUMA nodes and pinned as options say. Each worker has a local queue,
+/// each node has a lock-free injection queue for handles that come from outside the pool. Idle workers look
+/// for work on their own node first, and only go to remote nodes if their node has nothing.
+/// Coroutines created on a worker thread get their frames from the node's frame_arena.
+/// The handle a worker queued last goes into its LIFO slot and runs next, while its data is still in the cache.
+/// If max_threads allows, a worker that enters a blocking_region hands its queue to a new or
+/// idle thread, so the pool keeps its throughput while some of its threads are blocked.
+/// </summary>
+/// <remarks>
+/// The constructor throws std::system_error if the workers' affinity or policy cannot be applied.
+/// The pool finishes all queued work before the destructor returns. It also waits for threads in blocking regions.
+/// Create via std::make_shared, like other schedulers.
+/// </remarks>
+class thread_pool_scheduler : public scheduler {
+public:
+	explicit thread_pool_scheduler(thread_pool_options options = {});
+	thread_pool_scheduler(const thread_pool_scheduler&) = delete;
+	thread_pool_scheduler& operator=(const thread_pool_scheduler&) = delete;
+	~thread_pool_scheduler();
+
+	/// <summary> Number of work queues, which is the number of threads taking work at any time. </summary>
+	size_t num_workers() const;
+	/// <summary> Number of threads, including blocked and idle compensating ones. </summary>
+	size_t num_threads() const;
+	size_t num_nodes() const;
+	/// <summary> Index of the calling worker thread in this pool, or -1 if it's not one of the pool's threads. </summary>
+	ptrdiff_t current_worker() const;
+	/// <summary> True if the calling worker's queue is empty, so nothing is left for thieves. Always true outside the pool. </summary>
+	bool needs_work() const override;
+	scheduler_metrics metrics() const override;
+
+	/// <summary>
+	/// Starts a coroutine for each callable of the range and returns their futures.
+	/// The handles are submitted together, in chunks that workers take at once, so the cost per
+	/// task is much lower than calling schedule and starting each future one by one.
+	/// </summary>
+	template <std::ranges::input_range Range>
+	auto schedule_batch(Range&& funcs);
+
+protected:
+	void queue_for_resume(std::coroutine_handle<> handle) override;
+	/// <summary> Batches of a chunk or more go to the injection queues, so idle workers take them a chunk at a time. </summary>
+	void queue_for_resume_batch(std::span<const std::coroutine_handle<>> handles) override;
+
+private:
+	friend class blocking_region;
+	struct work_queue;
+	struct injection_queue;
+	struct batch;
+	struct worker;
+	struct node;
+
+	void thread_main(worker* slot);
+	void run(worker& self);
+	bool hand_off(worker& slot);
+	worker* reclaim(worker& slot);
+	worker* wait_for_slot();
+	void shutdown();
+	void submit(std::span<const std::coroutine_handle<>> handles);
+	void inject(std::span<const std::coroutine_handle<>> handles);
+	std::coroutine_handle<> find_work(worker& self);
+	std::coroutine_handle<> take_injected(worker& self, node& source);
+	std::coroutine_handle<> steal(worker& self, const node& victim_node);
+	std::coroutine_handle<> steal_next(worker& self, const node& victim_node);
+	/// <summary> Returns when work may have been queued, or at retry_at (steady_clock nanoseconds) unless it's zero. </summary>
+	void wait_for_work(uint32_t epoch, int64_t retry_at);
+	void wake(size_t count);
+
+private:
+	std::vector<std::unique_ptr<node>> m_nodes;
+	std::vector<std::unique_ptr<worker>> m_workers;
+	std::atomic_size_t m_next_node = 0;
+	std::atomic_bool m_stop = false;
+	std::chrono::steady_clock::time_point m_created = std::chrono::steady_clock::now();
+
+	/// <summary> Changes whenever work is queued while a worker is idle. Parked workers wait on it. </summary>
+	std::atomic_uint32_t m_epoch = 0;
+	/// <summary> The number of workers spinning, yielding or parked. Queuing work costs no shared write when it's zero. </summary>
+	std::atomic_size_t m_idle_workers = 0;
+	/// <summary> The number of parked workers. Nobody is woken when it's zero. </summary>
+	std::atomic_size_t m_sleeping = 0;
+	idle_policy m_idle;
+	size_t m_lifo_limit = 0;
+
+	size_t m_max_threads = 0;
+	std::chrono::milliseconds m_idle_timeout;
+	thread_policy m_policy;
+	mutable std::mutex m_threads_mtx;
+	std::condition_variable m_spare_cv;
+	std::condition_variable m_exit_cv;
+	size_t m_num_threads = 0;
+	size_t m_num_spares = 0;
+	/// <summary> Workers whose thread entered a blocking region, waiting for a spare thread or for their thread to come back. </summary>
+	std::vector<worker*> m_orphans;
+
+	/// <summary> The worker the current thread is running, nullptr if none. </summary>
+	static thread_local worker* tls_worker;
+	/// <summary> The pool the current thread belongs to. </summary>
+	static thread_local thread_pool_scheduler* tls_pool;
+	/// <summary> Collects the handles that schedule_batch starts on the current thread. </summary>
+	static thread_local batch* tls_batch;
+};
+
+
+struct thread_pool_scheduler::batch {
+	explicit batch(thread_pool_scheduler& pool);
+	batch(const batch&) = delete;
+	batch& operator=(const batch&) = delete;
+	~batch();
+
+	thread_pool_scheduler& m_pool;
+	std::vector<std::coroutine_handle<>> m_handles;
+	std::shared_ptr<scheduler_base> m_scheduler;
+	batch* m_previous;
+	frame_arena* m_arena;
+};
+
+
+template <std::ranges::input_range Range>
+auto thread_pool_scheduler::schedule_batch(Range&& funcs) {
+	using func_t = std::ranges::range_value_t<Range>;
+	using future_t = decltype(launch(std::declval<func_t>()));
+	std::vector<future_t> futures;
+	if constexpr (std::ranges::sized_range<Range>) {
+		futures.reserve(std::ranges::size(funcs));
+	}
+	batch pending(*this);
+	for (auto&& func : funcs) {
+		futures.push_back(launch(func_t(func)));
+		futures.back().start();
+	}
+	return futures;
+}
+
+
+/// <summary>
+/// Marks a part of a coroutine that blocks its thread, such as a synchronous legacy call.
+/// On a worker of a thread_pool_scheduler that may grow (see max_threads), the worker's queue
+/// is handed to another thread, so the rest of the pool's work keeps flowing while this one is blocked.
+/// When the region ends, the thread takes its worker back if no other thread took it over yet,
+/// or else the worker of another blocked thread that's still waiting for one. If there is none, it finishes
+/// the current coroutine without a worker, then idles as a spare until it's needed again or times out.
+/// Does nothing on other threads.
+/// </summary>
+class blocking_region {
+public:
+	blocking_region();
+	blocking_region(const blocking_region&) = delete;
+	blocking_region& operator=(const blocking_region&) = delete;
+	~blocking_region();
+
+	/// <summary> True if another thread took over the worker's queue. </summary>
+	bool compensated() const { return m_compensated; }
+
+private:
+	bool m_compensated = false;
+	thread_pool_scheduler* m_pool = nullptr;
+	thread_pool_scheduler::worker* m_slot = nullptr;
+};
+
+
+} // namespace cppjobs
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "../scheduler.hpp"
+#include "../trace.hpp"
+
+
+namespace cppjobs {
+
+/// <summary>
+/// Wraps a scheduler to record when coroutines are queued on it, see tracer.
+/// The time between queue and resume is how long a ready coroutine waited for a thread.
+/// </summary>
+/// <typeparam name="Scheduler"> The scheduler to trace. </typeparam>
+template <class Scheduler>
+class tracing_scheduler : public Scheduler {
+public:
+	using Scheduler::Scheduler;
+
+protected:
+	void queue_for_resume(std::coroutine_handle<> handle) override {
+		tracer::record(trace_event::queue, handle.address());
+		Scheduler::queue_for_resume(handle);
+	}
+	void queue_for_resume_batch(std::span<const std::coroutine_handle<>> handles) override {
+		for (auto handle : handles) {
+			tracer::record(trace_event::queue, handle.address());
+		}
+		Scheduler::queue_for_resume_batch(handles);
+	}
+};
+
+
+} // namespace cppjobs
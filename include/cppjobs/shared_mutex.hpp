@@ -3,6 +3,8 @@
 #include "future.hpp"
 #include "mutex.hpp"
 
+#include <string_view>
+
 namespace cppjobs {
 
 /// <summary>
@@ -44,6 +46,8 @@ class shared_mutex {
 	
 public:
 	shared_mutex() = default;
+	/// <summary> Names the mutex for lock_profiler. Readers waiting on writers are reported under name + "/readers". </summary>
+	explicit shared_mutex(std::string_view name);
 	shared_mutex(const shared_mutex&) = delete;
 	shared_mutex(shared_mutex&&) = delete;
 	shared_mutex& operator=(const shared_mutex&) = delete;
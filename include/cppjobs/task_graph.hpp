@@ -0,0 +1,96 @@
+#pragma once
+
+#include "future.hpp"
+#include "scheduler_base.hpp"
+#include "type_traits.hpp"
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+namespace cppjobs {
+
+/// <summary>
+/// A static graph of tasks with dependencies declared up front.
+/// Every node keeps a counter of unfinished predecessors. The node that brings a successor's counter
+/// to zero queues the successor on the scheduler, so running the graph needs no futures or awaiter lists.
+/// Each node runs in a coroutine created on the first run and reused by later ones,
+/// so repeated runs allocate nothing, apart from the frames of coroutine nodes themselves.
+/// </summary>
+/// <remarks>
+/// Don't modify or destroy the graph while a run is in progress, and don't start overlapping runs.
+/// If a node throws, the nodes that haven't started yet are skipped and the run rethrows the first exception.
+/// </remarks>
+class task_graph {
+public:
+	using node_id = size_t;
+
+	task_graph() = default;
+	task_graph(const task_graph&) = delete;
+	task_graph& operator=(const task_graph&) = delete;
+	~task_graph();
+
+	/// <summary> Adds a node that calls func. If func returns an awaitable, the node finishes once that does. </summary>
+	template <class Func>
+	node_id add(Func func);
+	/// <summary> Makes after wait for before. </summary>
+	void precede(node_id before, node_id after);
+	size_t size() const;
+
+	/// <summary> Runs all nodes on the scheduler. The future throws std::logic_error if the graph has a cycle or is already running. </summary>
+	future<void> run(std::shared_ptr<scheduler_base> sched);
+
+private:
+	struct node {
+		std::function<void()> m_func;
+		std::function<future<void>()> m_coro;
+		std::vector<node*> m_successors;
+		size_t m_predecessors = 0;
+		std::atomic_size_t m_pending = 0;
+		std::coroutine_handle<> m_loop;
+	};
+	struct loop_task;
+	struct node_finished;
+	struct run_finished;
+
+	node_id add_node(std::function<void()> func, std::function<future<void>()> coro);
+	loop_task loop(node& self);
+	void validate();
+	void finish_node();
+
+private:
+	std::vector<std::unique_ptr<node>> m_nodes;
+	bool m_validated = false;
+
+	std::shared_ptr<scheduler_base> m_scheduler;
+	std::atomic_bool m_running = false;
+	/// <summary> Nodes that haven't finished, plus one for the run itself until it's suspended. </summary>
+	std::atomic_size_t m_remaining = 0;
+	std::coroutine_handle<> m_waiting;
+	std::atomic_bool m_failed = false;
+	std::mutex m_error_mtx;
+	std::exception_ptr m_error;
+};
+
+
+template <class Func>
+task_graph::node_id task_graph::add(Func func) {
+	using result_t = std::invoke_result_t<Func&>;
+	if constexpr (std::is_convertible_v<result_t, future<void>>) {
+		return add_node(nullptr, std::move(func));
+	}
+	else if constexpr (awaitable<result_t>) {
+		return add_node(nullptr, [func = std::move(func)]() mutable -> future<void> { co_await func(); });
+	}
+	else {
+		return add_node(std::move(func), nullptr);
+	}
+}
+
+
+} // namespace cppjobs
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <optional>
+#include <system_error>
+#include <vector>
+
+
+namespace cppjobs {
+
+enum class scheduling_policy {
+	inherit, ///< Keep whatever the creating thread had.
+	normal, ///< SCHED_OTHER
+	batch, ///< SCHED_BATCH
+	idle, ///< SCHED_IDLE
+	fifo, ///< SCHED_FIFO, real-time, needs privileges.
+	round_robin, ///< SCHED_RR, real-time, needs privileges.
+};
+
+
+struct thread_policy {
+	scheduling_policy policy = scheduling_policy::inherit;
+	/// <summary> Static priority for the real-time policies, ignored otherwise. </summary>
+	int priority = 0;
+	/// <summary> Niceness of the thread (-20 to 19), only for the non real-time policies. </summary>
+	std::optional<int> nice;
+};
+
+
+/// <summary> Restricts the calling thread to the given CPUs. Does nothing for an empty list. </summary>
+std::error_code set_thread_affinity(const std::vector<size_t>& cpus);
+
+/// <summary> Applies the scheduling policy and niceness to the calling thread. </summary>
+std::error_code set_thread_policy(const thread_policy& policy);
+
+
+} // namespace cppjobs
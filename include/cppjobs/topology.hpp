@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+
+namespace cppjobs {
+
+struct numa_node {
+	size_t id = 0;
+	/// <summary> Logical CPUs of the node that this process is allowed to run on. </summary>
+	std::vector<size_t> cpus;
+	/// <summary> Relative access cost to other nodes, indexed by node id. Empty if unknown. </summary>
+	std::vector<size_t> distances;
+};
+
+
+/// <summary>
+/// Reads the NUMA layout of the machine from /sys/devices/system/node.
+/// Nodes without usable CPUs are left out. When the layout is not available
+/// (not Linux, no sysfs), a single node with all hardware threads is reported.
+/// </summary>
+std::vector<numa_node> system_topology();
+
+/// <summary> Parses the sysfs cpulist format, e.g. "0-3,8,10-11". </summary>
+std::vector<size_t> parse_cpu_list(const char* list);
+
+
+} // namespace cppjobs
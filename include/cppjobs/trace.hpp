@@ -0,0 +1,133 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+namespace cppjobs {
+
+enum class trace_event : uint8_t {
+	create, ///< The coroutine's frame was allocated.
+	start, ///< The lazy coroutine was started for the first time.
+	queue, ///< The coroutine was handed to a scheduler, it's ready to run.
+	resume, ///< A thread started running the coroutine.
+	suspend, ///< The thread got control back from the coroutine.
+	finish, ///< The coroutine reached its final suspend point.
+};
+
+
+/// <summary>
+/// Records the lifecycle of coroutines into per-thread ring buffers, to be exported as a Chrome trace.
+/// Futures record create, start and finish, schedulers record resume and suspend around running a coroutine,
+/// and tracing_scheduler records when coroutines are queued. The gaps between the events show how long
+/// a coroutine waited for something, how long it waited for a thread, and how long it ran.
+/// Recording is off by default, and costs a relaxed load when off.
+/// </summary>
+/// <remarks>
+/// Each thread writes its own buffer without locks. When a buffer is full the oldest events are overwritten.
+/// On x86, events are stamped with the time stamp counter, which must be invariant and in sync across cores,
+/// as it is on CPUs of the last decade. It's converted to time when the trace is written.
+/// Coroutines are identified by their frame address, which is reused once the frame is freed.
+/// </remarks>
+class tracer {
+	struct buffer;
+	struct registry;
+	struct thread_guard;
+
+public:
+	/// <summary> Events each thread keeps until they are written out. </summary>
+	static constexpr size_t buffer_capacity = size_t(1) << 16;
+
+	static void enable(bool enabled = true) { m_enabled.store(enabled, std::memory_order_relaxed); }
+	static bool enabled() { return m_enabled.load(std::memory_order_relaxed); }
+
+	static void record(trace_event event, const void* coroutine) noexcept;
+	/// <summary> Resumes the coroutine, and records when it runs if tracing is on. </summary>
+	static void resume(std::coroutine_handle<> handle);
+
+	/// <summary>
+	/// Writes the events recorded since the last call in the Chrome trace event format, and drops them.
+	/// Open the file in chrome://tracing or ui.perfetto.dev.
+	/// </summary>
+	static void write_chrome_trace(std::ostream& out);
+	/// <summary> Drops the recorded events. </summary>
+	static void clear();
+
+private:
+	/// <summary> Raw timestamp: CPU ticks on x86, nanoseconds of steady_clock elsewhere. </summary>
+	static int64_t timestamp() noexcept;
+	static buffer* attach();
+	static registry& buffers();
+
+private:
+	struct slot {
+		std::atomic<int64_t> m_time;
+		std::atomic<const void*> m_coroutine;
+		std::atomic<trace_event> m_event;
+	};
+	struct buffer {
+		std::unique_ptr<slot[]> m_slots = std::make_unique<slot[]>(buffer_capacity);
+		/// <summary> Number of events ever written. Only the owner thread writes it. </summary>
+		std::atomic_uint64_t m_head = 0;
+		/// <summary> Number of events already written out. Only readers under the registry's lock touch it. </summary>
+		uint64_t m_tail = 0;
+		size_t m_thread = 0;
+		/// <summary> The owner thread has exited, the buffer is freed once it's read. </summary>
+		std::atomic_bool m_retired = false;
+	};
+
+	inline static std::atomic_bool m_enabled = false;
+	inline static thread_local buffer* tls_buffer = nullptr;
+	/// <summary> Retires the thread's buffer when the thread exits. Not touched on the fast path, unlike tls_buffer. </summary>
+	static thread_local thread_guard tls_guard;
+};
+
+
+inline void tracer::record(trace_event event, const void* coroutine) noexcept {
+	if (!enabled()) {
+		return;
+	}
+	buffer* const target = tls_buffer ? tls_buffer : attach();
+	if (target == nullptr) {
+		return;
+	}
+	const uint64_t head = target->m_head.load(std::memory_order_relaxed);
+	slot& item = target->m_slots[head & (buffer_capacity - 1)];
+	item.m_time.store(timestamp(), std::memory_order_relaxed);
+	item.m_coroutine.store(coroutine, std::memory_order_relaxed);
+	item.m_event.store(event, std::memory_order_relaxed);
+	target->m_head.store(head + 1, std::memory_order_release);
+}
+
+
+inline int64_t tracer::timestamp() noexcept {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	return int64_t(__rdtsc());
+#elif defined(__x86_64__) || defined(__i386__)
+	return int64_t(__builtin_ia32_rdtsc());
+#else
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+
+inline void tracer::resume(std::coroutine_handle<> handle) {
+	if (!enabled()) {
+		handle.resume();
+		return;
+	}
+	const void* const coroutine = handle.address(); // The frame may be gone when resume returns.
+	record(trace_event::resume, coroutine);
+	handle.resume();
+	record(trace_event::suspend, coroutine);
+}
+
+
+} // namespace cppjobs
@@ -0,0 +1,57 @@
+#include <cppjobs/async_scope.hpp>
+
+#include <utility>
+
+
+namespace cppjobs {
+
+
+void async_scope::child_task::final_awaitable::await_suspend(std::coroutine_handle<> child) const noexcept {
+	async_scope* const scope = m_scope;
+	child.destroy();
+	// The joiner may destroy the scope, so it's the last thing to touch.
+	if (scope->m_pending.fetch_sub(1) == 1) {
+		scope->m_joiner.resume();
+	}
+}
+
+
+void async_scope::join_awaitable::await_resume() {
+	// Every child has finished, nobody else touches the scope until the next spawn.
+	m_scope->m_pending.store(1);
+	if (auto error = std::exchange(m_scope->m_error, nullptr)) {
+		std::rethrow_exception(error);
+	}
+}
+
+
+async_scope::async_scope(std::shared_ptr<scheduler_base> sched)
+	: m_scheduler(std::move(sched)) {}
+
+async_scope::~async_scope() {
+	if (m_pending.load() != 1) {
+		std::terminate(); // Children would be left with dangling references.
+	}
+}
+
+auto async_scope::join() -> join_awaitable {
+	return { this };
+}
+
+void async_scope::launch(child_task child) {
+	m_pending.fetch_add(1);
+	auto& promise = child.m_handle.promise();
+	promise.m_scope = this;
+	promise.m_scheduler = m_scheduler;
+	m_scheduler->queue_for_resume(child.m_handle);
+}
+
+void async_scope::record(std::exception_ptr error) {
+	std::lock_guard lk(m_error_mtx);
+	if (!m_error) {
+		m_error = std::move(error);
+	}
+}
+
+
+} // namespace cppjobs
@@ -0,0 +1,234 @@
+#include <algorithm>
+#include <array>
+#include <csignal>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <cppjobs/coroutine_registry.hpp>
+
+
+namespace cppjobs {
+
+
+namespace {
+	constexpr size_t num_shards = 16;
+
+	struct shard {
+		std::mutex m_mtx;
+		coroutine_record* m_first = nullptr;
+	};
+
+	std::array<shard, num_shards>& shards() {
+		static auto* instance = new std::array<shard, num_shards>; // Never freed, frames may be freed while static objects are destroyed.
+		return *instance;
+	}
+
+	struct thread_ids {
+		size_t m_thread;
+		uint64_t m_next = 0;
+	};
+
+	thread_ids& local_ids() {
+		static std::atomic_size_t next_thread = 0;
+		thread_local thread_ids ids{ next_thread.fetch_add(1, std::memory_order_relaxed) };
+		return ids;
+	}
+
+	uint64_t next_id() {
+		// Threads hand out ids from their own range, so that creating coroutines doesn't contend on a counter.
+		auto& ids = local_ids();
+		return (uint64_t(ids.m_thread + 1) << 40) | ++ids.m_next;
+	}
+
+	const char* kind_name(await_kind kind) {
+		switch (kind) {
+			case await_kind::none: return "nothing known";
+			case await_kind::mutex: return "mutex";
+			case await_kind::future: return "future";
+		}
+		return "unknown";
+	}
+
+	std::atomic_bool dump_requested = false;
+
+	void request_dump(int signal) {
+		dump_requested.store(true);
+		std::signal(signal, request_dump); // Some platforms reset the handler when it's called.
+	}
+} // namespace
+
+
+coroutine_record::coroutine_record()
+	: m_id(next_id()), m_shard(local_ids().m_thread % num_shards) {
+	auto& target = shards()[m_shard];
+	std::lock_guard lk(target.m_mtx);
+	m_next = target.m_first;
+	if (m_next != nullptr) {
+		m_next->m_prev = this;
+	}
+	target.m_first = this;
+}
+
+
+coroutine_record::~coroutine_record() {
+	auto& target = shards()[m_shard];
+	std::lock_guard lk(target.m_mtx);
+	(m_prev != nullptr ? m_prev->m_next : target.m_first) = m_next;
+	if (m_next != nullptr) {
+		m_next->m_prev = m_prev;
+	}
+}
+
+
+void coroutine_record::set_label(std::string_view label) {
+	std::lock_guard lk(shards()[m_shard].m_mtx);
+	m_label = label;
+}
+
+
+void coroutine_record::waits_on(await_kind kind, const void* object, uint64_t target) noexcept {
+	m_object.store(object, std::memory_order_relaxed);
+	m_target.store(target, std::memory_order_relaxed);
+	m_suspended_at.store(now(), std::memory_order_relaxed);
+	m_kind.store(kind, std::memory_order_release);
+}
+
+
+void coroutine_record::resumed() noexcept {
+	m_kind.store(await_kind::none, std::memory_order_relaxed);
+}
+
+
+int64_t coroutine_record::now() noexcept {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+std::vector<coroutine_info> coroutine_registry::snapshot() {
+	std::vector<coroutine_info> result;
+	const int64_t now = coroutine_record::now();
+	for (auto& source : shards()) {
+		std::lock_guard lk(source.m_mtx);
+		for (auto record = source.m_first; record != nullptr; record = record->m_next) {
+			coroutine_info item;
+			item.id = record->m_id;
+			item.label = record->m_label;
+			item.kind = record->m_kind.load(std::memory_order_acquire);
+			if (item.kind != await_kind::none) {
+				item.object = record->m_object.load(std::memory_order_relaxed);
+				item.waits_for = record->m_target.load(std::memory_order_relaxed);
+				item.suspended_for = std::chrono::nanoseconds(now - record->m_suspended_at.load(std::memory_order_relaxed));
+			}
+			result.push_back(std::move(item));
+		}
+	}
+	std::ranges::stable_sort(result, [](const coroutine_info& lhs, const coroutine_info& rhs) {
+		return lhs.suspended_for > rhs.suspended_for;
+	});
+	return result;
+}
+
+
+std::vector<std::vector<uint64_t>> coroutine_registry::find_cycles(const std::vector<coroutine_info>& coroutines) {
+	// Each coroutine waits for one other at most, so following the edges from any of them
+	// either runs out, or runs into a cycle.
+	std::unordered_map<uint64_t, uint64_t> edges;
+	for (const auto& item : coroutines) {
+		if (item.kind != await_kind::none && item.waits_for != 0) {
+			edges[item.id] = item.waits_for;
+		}
+	}
+	enum class color { unvisited, on_path, done };
+	std::unordered_map<uint64_t, color> colors;
+	std::vector<std::vector<uint64_t>> cycles;
+	for (const auto& [start, first_target] : edges) {
+		std::vector<uint64_t> path;
+		uint64_t current = start;
+		while (true) {
+			auto& state = colors[current];
+			if (state == color::done) {
+				break;
+			}
+			if (state == color::on_path) {
+				cycles.emplace_back(std::ranges::find(path, current), path.end());
+				break;
+			}
+			state = color::on_path;
+			path.push_back(current);
+			const auto edge = edges.find(current);
+			if (edge == edges.end()) {
+				break;
+			}
+			current = edge->second;
+		}
+		for (auto id : path) {
+			colors[id] = color::done;
+		}
+	}
+	return cycles;
+}
+
+
+void coroutine_registry::dump(std::ostream& out) {
+	const auto coroutines = snapshot();
+	std::unordered_map<uint64_t, const coroutine_info*> by_id;
+	for (const auto& item : coroutines) {
+		by_id[item.id] = &item;
+	}
+	auto describe = [&](uint64_t id) {
+		char text[64];
+		const auto it = by_id.find(id);
+		if (id == 0) {
+			std::snprintf(text, sizeof(text), "an unknown holder");
+		}
+		else if (it == by_id.end()) {
+			std::snprintf(text, sizeof(text), "#%llx (finished)", static_cast<unsigned long long>(id));
+		}
+		else {
+			std::snprintf(text, sizeof(text), "#%llx", static_cast<unsigned long long>(id));
+		}
+		return std::string(text) + (it != by_id.end() && !it->second->label.empty() ? " \"" + it->second->label + "\"" : "");
+	};
+
+	size_t waiting = 0;
+	char line[128];
+	for (const auto& item : coroutines) {
+		if (item.kind == await_kind::none) {
+			continue;
+		}
+		++waiting;
+		std::snprintf(line, sizeof(line), " waits %.3f ms on %s %p %s ",
+					  std::chrono::duration<double, std::milli>(item.suspended_for).count(), kind_name(item.kind), item.object,
+					  item.kind == await_kind::mutex ? "held by" : "computed by");
+		out << describe(item.id) << line << describe(item.waits_for) << "\n";
+	}
+	out << coroutines.size() << " live coroutines, " << waiting << " waiting on a mutex or future\n";
+	for (const auto& cycle : find_cycles(coroutines)) {
+		out << "deadlock:";
+		for (auto id : cycle) {
+			out << " " << describe(id) << " ->";
+		}
+		out << " " << describe(cycle.front()) << "\n";
+	}
+}
+
+
+void coroutine_registry::dump_on_signal(int signal) {
+	static std::once_flag watcher;
+	std::call_once(watcher, [] {
+		std::thread([] {
+			while (true) {
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+				if (dump_requested.exchange(false)) {
+					dump(std::cerr);
+				}
+			}
+		}).detach();
+	});
+	std::signal(signal, request_dump);
+}
+
+
+} // namespace cppjobs
@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <cppjobs/frame_accounting.hpp>
+#include <cppjobs/frame_arena.hpp>
+
+
+namespace cppjobs {
+
+
+struct frame_accounting::site {
+	const char* m_function;
+	const char* m_file;
+	uint32_t m_line;
+	uint32_t m_column;
+	/// <summary> Written once, the frame size is a constant of the function. </summary>
+	std::atomic_size_t m_frame_size = 0;
+	std::atomic_uint64_t m_allocations = 0;
+	std::atomic_uint64_t m_deallocations = 0;
+};
+
+
+namespace {
+	constexpr size_t table_size = 4096;
+} // namespace
+
+
+struct frame_accounting::site_table {
+	std::mutex m_mtx;
+	/// <summary> Open addressing, sites are only ever added, so lookups need no lock. </summary>
+	std::array<std::atomic<site*>, table_size> m_slots = {};
+	size_t m_count = 0;
+};
+
+
+auto frame_accounting::sites() -> site_table& {
+	static auto* instance = new site_table; // Never freed, frames may be freed while static objects are destroyed.
+	return *instance;
+}
+
+
+auto frame_accounting::find_site(const std::source_location& location) -> site& {
+	// The strings of a source_location are literals, so the same call site always has the same pointers.
+	const size_t hash = std::hash<const void*>{}(location.function_name()) ^ (size_t(location.line()) * 0x9E3779B97F4A7C15ull) ^ location.column();
+	auto matches = [&](const site* item) {
+		return item->m_function == location.function_name() && item->m_line == location.line() && item->m_column == location.column();
+	};
+	auto& table = sites();
+	for (size_t probe = 0; probe < table_size; ++probe) {
+		site* const item = table.m_slots[(hash + probe) % table_size].load(std::memory_order_acquire);
+		if (item == nullptr) {
+			break;
+		}
+		if (matches(item)) {
+			return *item;
+		}
+	}
+
+	std::lock_guard lk(table.m_mtx);
+	for (size_t probe = 0; probe < table_size; ++probe) {
+		auto& slot = table.m_slots[(hash + probe) % table_size];
+		site* const item = slot.load(std::memory_order_relaxed);
+		if (item != nullptr && matches(item)) {
+			return *item;
+		}
+		// The last slot is kept free, so that lookups always terminate.
+		if (item == nullptr && table.m_count + 1 < table_size) {
+			++table.m_count;
+			site* const created = new site{ location.function_name(), location.file_name(), location.line(), location.column() };
+			slot.store(created, std::memory_order_release);
+			return *created;
+		}
+	}
+	static site overflow{ "(other)", "", 0, 0 };
+	return overflow;
+}
+
+
+void* frame_accounting::allocate(size_t size, const std::source_location& location) {
+	site& owner = find_site(location);
+	void* const block = frame_arena::allocate(size + header_size);
+	*static_cast<site**>(block) = &owner;
+	// Totals and byte counts are derived from these two when read, to keep allocation cheap.
+	owner.m_allocations.fetch_add(1, std::memory_order_relaxed);
+	if (owner.m_frame_size.load(std::memory_order_relaxed) != size) {
+		owner.m_frame_size.store(size, std::memory_order_relaxed);
+	}
+	return static_cast<std::byte*>(block) + header_size;
+}
+
+
+void frame_accounting::deallocate(void* ptr, size_t size) noexcept {
+	void* const block = static_cast<std::byte*>(ptr) - header_size;
+	site& owner = **static_cast<site**>(block);
+	owner.m_deallocations.fetch_add(1, std::memory_order_relaxed);
+	frame_arena::deallocate(block, size + header_size);
+}
+
+
+frame_stats frame_accounting::snapshot() {
+	frame_stats result;
+	for (const auto& slot : sites().m_slots) {
+		const site* const item = slot.load(std::memory_order_acquire);
+		if (item == nullptr) {
+			continue;
+		}
+		frame_site_stats stats;
+		stats.function = item->m_function;
+		stats.file = item->m_file;
+		stats.line = item->m_line;
+		stats.frame_size = item->m_frame_size.load(std::memory_order_relaxed);
+		stats.allocations = item->m_allocations.load(std::memory_order_relaxed);
+		// Read after the allocations, so that a frame allocated and freed in between doesn't make it negative.
+		stats.live_frames = stats.allocations - std::min(stats.allocations, item->m_deallocations.load(std::memory_order_relaxed));
+		stats.live_bytes = stats.live_frames * stats.frame_size;
+		result.allocations += stats.allocations;
+		result.allocated_bytes += stats.allocations * stats.frame_size;
+		result.live_frames += stats.live_frames;
+		result.live_bytes += stats.live_bytes;
+		result.sites.push_back(stats);
+	}
+	std::ranges::stable_sort(result.sites, [](const frame_site_stats& lhs, const frame_site_stats& rhs) {
+		return lhs.live_bytes != rhs.live_bytes ? lhs.live_bytes > rhs.live_bytes : lhs.allocations > rhs.allocations;
+	});
+	return result;
+}
+
+
+void frame_accounting::report(std::ostream& out, size_t count) {
+	const auto stats = snapshot();
+	char line[512];
+	std::snprintf(line, sizeof(line), "%llu frames, %llu bytes live, %llu frames of %llu bytes allocated in total\n",
+				  static_cast<unsigned long long>(stats.live_frames),
+				  static_cast<unsigned long long>(stats.live_bytes),
+				  static_cast<unsigned long long>(stats.allocations),
+				  static_cast<unsigned long long>(stats.allocated_bytes));
+	out << line;
+	std::snprintf(line, sizeof(line), "%10s %12s %14s %14s  %s\n", "frame [B]", "live frames", "live bytes", "allocations", "function");
+	out << line;
+	for (size_t index = 0; index < std::min(count, stats.sites.size()); ++index) {
+		const auto& item = stats.sites[index];
+		std::snprintf(line, sizeof(line), "%10zu %12llu %14llu %14llu  %s (%s:%u)\n",
+					  item.frame_size,
+					  static_cast<unsigned long long>(item.live_frames),
+					  static_cast<unsigned long long>(item.live_bytes),
+					  static_cast<unsigned long long>(item.allocations),
+					  item.function, item.file, static_cast<unsigned>(item.line));
+		out << line;
+	}
+}
+
+
+} // namespace cppjobs
@@ -0,0 +1,147 @@
+#include <bit>
+#include <new>
+#include <vector>
+#include <cppjobs/frame_arena.hpp>
+
+
+namespace cppjobs {
+
+
+namespace {
+	struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) frame_header {
+		frame_arena* m_arena;
+		size_t m_size_class;
+	};
+
+	constexpr size_t chunk_size = 256 * 1024;
+	constexpr size_t refill_count = 32;
+	constexpr size_t cache_capacity = 2 * refill_count;
+
+	size_t size_class_of(size_t bytes) {
+		return std::bit_width((bytes - 1) / frame_arena::min_block_size);
+	}
+} // namespace
+
+
+struct frame_arena::thread_cache {
+	frame_arena* m_arena = nullptr;
+	std::array<block*, num_size_classes> m_free = {};
+	std::array<size_t, num_size_classes> m_count = {};
+
+	void flush() {
+		for (size_t size_class = 0; size_class < num_size_classes; ++size_class) {
+			if (m_count[size_class] == 0) {
+				continue;
+			}
+			block* last = m_free[size_class];
+			while (last->m_next != nullptr) {
+				last = last->m_next;
+			}
+			m_arena->release(m_free[size_class], last, size_class);
+			m_free[size_class] = nullptr;
+			m_count[size_class] = 0;
+		}
+	}
+	~thread_cache() {
+		flush();
+		m_arena = nullptr;
+	}
+};
+
+
+thread_local frame_arena::thread_cache frame_arena::tls_cache;
+
+
+frame_arena& frame_arena::for_node(size_t node) {
+	static std::mutex mtx;
+	// Never freed, frames can outlive whatever would own the arenas. The list stays reachable so that leak checkers agree.
+	static auto* arenas = new std::vector<frame_arena*>;
+	std::lock_guard lk(mtx);
+	if (arenas->size() <= node) {
+		arenas->resize(node + 1, nullptr);
+	}
+	if ((*arenas)[node] == nullptr) {
+		(*arenas)[node] = new frame_arena;
+	}
+	return *(*arenas)[node];
+}
+
+void frame_arena::bind_thread(frame_arena* arena) {
+	thread_cache& cache = tls_cache;
+	if (cache.m_arena != arena) {
+		cache.flush();
+		cache.m_arena = arena;
+	}
+}
+
+frame_arena* frame_arena::bound_arena() {
+	return tls_cache.m_arena;
+}
+
+void* frame_arena::allocate(size_t size) {
+	const size_t total = size + sizeof(frame_header);
+	thread_cache& cache = tls_cache;
+	if (cache.m_arena != nullptr && total <= max_block_size) {
+		const size_t size_class = size_class_of(total);
+		if (cache.m_free[size_class] == nullptr) {
+			cache.m_arena->refill(cache, size_class);
+		}
+		block* const free_block = cache.m_free[size_class];
+		cache.m_free[size_class] = free_block->m_next;
+		--cache.m_count[size_class];
+		return new (free_block) frame_header{ cache.m_arena, size_class } + 1;
+	}
+	return new (::operator new(total)) frame_header{ nullptr, 0 } + 1;
+}
+
+void frame_arena::deallocate(void* ptr, size_t size) noexcept {
+	frame_header* const header = static_cast<frame_header*>(ptr) - 1;
+	frame_arena* const arena = header->m_arena;
+	if (arena == nullptr) {
+		::operator delete(header, size + sizeof(frame_header));
+		return;
+	}
+	const size_t size_class = header->m_size_class;
+	block* const free_block = reinterpret_cast<block*>(header);
+	thread_cache& cache = tls_cache;
+	if (cache.m_arena == arena && cache.m_count[size_class] < cache_capacity) {
+		free_block->m_next = cache.m_free[size_class];
+		cache.m_free[size_class] = free_block;
+		++cache.m_count[size_class];
+		return;
+	}
+	arena->release(free_block, free_block, size_class);
+}
+
+void frame_arena::refill(thread_cache& cache, size_t size_class) {
+	std::lock_guard lk(m_mtx);
+	size_t count = 0;
+	while (count < refill_count && m_free[size_class] != nullptr) {
+		block* const free_block = m_free[size_class];
+		m_free[size_class] = free_block->m_next;
+		free_block->m_next = cache.m_free[size_class];
+		cache.m_free[size_class] = free_block;
+		++count;
+	}
+	const size_t block_size = min_block_size << size_class;
+	for (; count < refill_count; ++count) {
+		if (m_chunk_end - m_chunk_cursor < ptrdiff_t(block_size)) {
+			// The leftover of the previous chunk is abandoned, it is smaller than a block anyways.
+			m_chunk_cursor = static_cast<std::byte*>(::operator new(chunk_size, std::align_val_t{ min_block_size }));
+			m_chunk_end = m_chunk_cursor + chunk_size;
+		}
+		block* const free_block = new (m_chunk_cursor) block{ cache.m_free[size_class] };
+		m_chunk_cursor += block_size;
+		cache.m_free[size_class] = free_block;
+	}
+	cache.m_count[size_class] += count;
+}
+
+void frame_arena::release(block* first, block* last, size_t size_class) {
+	std::lock_guard lk(m_mtx);
+	last->m_next = m_free[size_class];
+	m_free[size_class] = first;
+}
+
+
+} // namespace cppjobs
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <bit>
+#include <exception>
+#include <cppjobs/frame_arena.hpp>
+#include <cppjobs/latency_histogram.hpp>
+#include <cppjobs/trace.hpp>
+
+
+namespace cppjobs {
+
+
+std::chrono::nanoseconds latency_distribution::mean() const {
+	return count > 0 ? total / int64_t(count) : std::chrono::nanoseconds(0);
+}
+
+
+std::chrono::nanoseconds latency_distribution::percentile(double fraction) const {
+	const double target = fraction * double(count);
+	uint64_t seen = 0;
+	for (size_t bucket = 0; bucket < num_buckets; ++bucket) {
+		seen += buckets[bucket];
+		if (seen > 0 && double(seen) >= target) {
+			return std::min(std::chrono::nanoseconds(bucket_upper(bucket)), max);
+		}
+	}
+	return max;
+}
+
+
+latency_distribution& latency_distribution::operator+=(const latency_distribution& other) {
+	count += other.count;
+	total += other.total;
+	max = std::max(max, other.max);
+	for (size_t bucket = 0; bucket < num_buckets; ++bucket) {
+		buckets[bucket] += other.buckets[bucket];
+	}
+	return *this;
+}
+
+
+size_t latency_distribution::bucket_of(int64_t ns) {
+	if (ns < int64_t(sub_buckets)) {
+		return ns > 0 ? size_t(ns) : 0;
+	}
+	const size_t exponent = std::bit_width(uint64_t(ns)) - 1;
+	if (exponent >= max_exponent) {
+		return num_buckets - 1;
+	}
+	const size_t sub = size_t(ns >> (exponent - sub_bits)) & (sub_buckets - 1);
+	return (exponent - sub_bits + 1) * sub_buckets + sub;
+}
+
+
+int64_t latency_distribution::bucket_upper(size_t bucket) {
+	if (bucket < sub_buckets) {
+		return int64_t(bucket);
+	}
+	const size_t shift = bucket / sub_buckets - 1;
+	const size_t sub = bucket % sub_buckets;
+	return int64_t(((sub_buckets + sub + 1) << shift) - 1);
+}
+
+
+void latency_histogram::record(int64_t ns) noexcept {
+	shard& target = m_shards[thread_shard()];
+	target.m_buckets[latency_distribution::bucket_of(ns)].fetch_add(1, std::memory_order_relaxed);
+	target.m_total.fetch_add(ns, std::memory_order_relaxed);
+	int64_t max = target.m_max.load(std::memory_order_relaxed);
+	while (ns > max && !target.m_max.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+	}
+}
+
+
+latency_distribution latency_histogram::snapshot() const {
+	latency_distribution result;
+	for (size_t index = 0; index < num_shards; ++index) {
+		const shard& source = m_shards[index];
+		for (size_t bucket = 0; bucket < latency_distribution::num_buckets; ++bucket) {
+			result.buckets[bucket] += source.m_buckets[bucket].load(std::memory_order_relaxed);
+		}
+		result.total += std::chrono::nanoseconds(source.m_total.load(std::memory_order_relaxed));
+		result.max = std::max(result.max, std::chrono::nanoseconds(source.m_max.load(std::memory_order_relaxed)));
+	}
+	for (auto count : result.buckets) {
+		result.count += count;
+	}
+	return result;
+}
+
+
+void latency_histogram::reset() {
+	for (size_t index = 0; index < num_shards; ++index) {
+		shard& target = m_shards[index];
+		for (auto& count : target.m_buckets) {
+			count.store(0, std::memory_order_relaxed);
+		}
+		target.m_total.store(0, std::memory_order_relaxed);
+		target.m_max.store(0, std::memory_order_relaxed);
+	}
+}
+
+
+int64_t latency_histogram::now() noexcept {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+size_t latency_histogram::thread_shard() noexcept {
+	static std::atomic_size_t next = 0;
+	thread_local const size_t index = next.fetch_add(1, std::memory_order_relaxed) % num_shards;
+	return index;
+}
+
+
+struct latency_recorder::probe {
+	struct promise_type {
+		probe get_return_object() { return { std::coroutine_handle<promise_type>::from_promise(*this) }; }
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+		static void* operator new(size_t size) { return frame_arena::allocate(size); }
+		static void operator delete(void* ptr, size_t size) { frame_arena::deallocate(ptr, size); }
+	};
+	std::coroutine_handle<promise_type> m_handle;
+};
+
+
+namespace {
+
+/// <summary> A probe resuming its handle on this thread. </summary>
+struct recording {
+	const latency_recorder* m_recorder;
+	recording* m_outer;
+	/// <summary> The owner's reference, if the handle released the owner. </summary>
+	std::shared_ptr<latency_recorder> m_released = nullptr;
+};
+
+thread_local recording* tls_recording = nullptr;
+
+} // namespace
+
+
+std::coroutine_handle<> latency_recorder::wrap(std::coroutine_handle<> handle) {
+	return run(this, handle, latency_histogram::now()).m_handle;
+}
+
+
+latency_recorder::probe latency_recorder::run(latency_recorder* self, std::coroutine_handle<> handle, int64_t queued_at) {
+	const int64_t resumed_at = latency_histogram::now();
+	self->m_queue_delay.record(resumed_at - queued_at);
+	// The handle may finish and release the scheduler, release() then leaves the owner's reference to current.
+	recording current{ self, tls_recording };
+	tls_recording = &current;
+	tracer::resume(handle);
+	self->m_execution.record(latency_histogram::now() - resumed_at);
+	tls_recording = current.m_outer;
+	co_return;
+}
+
+
+void latency_recorder::release(std::shared_ptr<latency_recorder> recorder) noexcept {
+	// The outermost probe of the recorder is the last one to record.
+	recording* keeper = nullptr;
+	for (recording* current = tls_recording; current != nullptr; current = current->m_outer) {
+		if (current->m_recorder == recorder.get()) {
+			keeper = current;
+		}
+	}
+	if (keeper != nullptr) {
+		keeper->m_released = std::move(recorder);
+	}
+}
+
+
+latency_summary latency_recorder::summary() const {
+	return { m_tag, m_queue_delay.snapshot(), m_execution.snapshot() };
+}
+
+
+void latency_recorder::reset() {
+	m_queue_delay.reset();
+	m_execution.reset();
+}
+
+
+} // namespace cppjobs
@@ -0,0 +1,164 @@
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <cppjobs/lock_profiler.hpp>
+
+
+namespace cppjobs {
+
+
+namespace {
+	struct registry {
+		std::mutex m_mtx;
+		std::map<std::string, std::unique_ptr<lock_profile>, std::less<>> m_profiles;
+	};
+
+	registry& profiles() {
+		static registry* instance = new registry; // Never freed, mutexes may be unlocked while static objects are destroyed.
+		return *instance;
+	}
+} // namespace
+
+
+std::chrono::nanoseconds lock_stats::hold_percentile(double fraction) const {
+	uint64_t total = 0;
+	for (auto count : hold_histogram) {
+		total += count;
+	}
+	const double target = fraction * double(total);
+	uint64_t seen = 0;
+	for (size_t bucket = 0; bucket < num_buckets; ++bucket) {
+		seen += hold_histogram[bucket];
+		if (seen > 0 && double(seen) >= target) {
+			return std::chrono::nanoseconds(int64_t(1) << (bucket + 1));
+		}
+	}
+	return std::chrono::nanoseconds(0);
+}
+
+
+lock_profile* lock_profile::get(std::string_view name) {
+	auto& shared = profiles();
+	std::lock_guard lk(shared.m_mtx);
+	auto it = shared.m_profiles.find(name);
+	if (it == shared.m_profiles.end()) {
+		it = shared.m_profiles.emplace(std::string(name), std::unique_ptr<lock_profile>(new lock_profile(std::string(name)))).first;
+	}
+	return it->second.get();
+}
+
+
+void lock_profile::acquired(int64_t wait_ns, bool contended) {
+	m_acquisitions.fetch_add(1, std::memory_order_relaxed);
+	if (contended) {
+		m_contended.fetch_add(1, std::memory_order_relaxed);
+		m_total_wait.fetch_add(wait_ns, std::memory_order_relaxed);
+		int64_t max = m_max_wait.load(std::memory_order_relaxed);
+		while (wait_ns > max && !m_max_wait.compare_exchange_weak(max, wait_ns, std::memory_order_relaxed)) {
+		}
+	}
+}
+
+
+void lock_profile::released(int64_t hold_ns, uint64_t waiters_walked) {
+	m_unlocks.fetch_add(1, std::memory_order_relaxed);
+	m_waiters_walked.fetch_add(waiters_walked, std::memory_order_relaxed);
+	const size_t bucket = hold_ns <= 1 ? 0 : std::min<size_t>(std::bit_width(uint64_t(hold_ns)) - 1, lock_stats::num_buckets - 1);
+	m_hold_histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+
+lock_stats lock_profile::stats() const {
+	lock_stats result;
+	result.name = m_name;
+	result.acquisitions = m_acquisitions.load(std::memory_order_relaxed);
+	result.contended = m_contended.load(std::memory_order_relaxed);
+	result.total_wait = std::chrono::nanoseconds(m_total_wait.load(std::memory_order_relaxed));
+	result.max_wait = std::chrono::nanoseconds(m_max_wait.load(std::memory_order_relaxed));
+	result.waiters_walked = m_waiters_walked.load(std::memory_order_relaxed);
+	result.unlocks = m_unlocks.load(std::memory_order_relaxed);
+	for (size_t bucket = 0; bucket < lock_stats::num_buckets; ++bucket) {
+		result.hold_histogram[bucket] = m_hold_histogram[bucket].load(std::memory_order_relaxed);
+	}
+	return result;
+}
+
+
+void lock_profile::reset() {
+	m_acquisitions = 0;
+	m_contended = 0;
+	m_total_wait = 0;
+	m_max_wait = 0;
+	m_waiters_walked = 0;
+	m_unlocks = 0;
+	for (auto& count : m_hold_histogram) {
+		count = 0;
+	}
+}
+
+
+int64_t lock_profile::now() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+std::vector<lock_stats> lock_profiler::snapshot() {
+	std::vector<lock_stats> result;
+	{
+		auto& shared = profiles();
+		std::lock_guard lk(shared.m_mtx);
+		for (const auto& [name, profile] : shared.m_profiles) {
+			result.push_back(profile->stats());
+		}
+	}
+	std::ranges::stable_sort(result, [](const lock_stats& lhs, const lock_stats& rhs) {
+		return lhs.total_wait != rhs.total_wait ? lhs.total_wait > rhs.total_wait : lhs.contended > rhs.contended;
+	});
+	return result;
+}
+
+
+std::vector<lock_stats> lock_profiler::top_contended(size_t count) {
+	auto result = snapshot();
+	if (result.size() > count) {
+		result.resize(count);
+	}
+	return result;
+}
+
+
+void lock_profiler::report(std::ostream& out, size_t count) {
+	char line[256];
+	std::snprintf(line, sizeof(line), "%-32s %12s %10s %14s %14s %12s %12s %10s\n",
+				  "lock", "acquisitions", "contended", "wait [ms]", "max wait [us]", "hold p50", "hold p99", "walked");
+	out << line;
+	for (const auto& item : top_contended(count)) {
+		const double contended = item.acquisitions > 0 ? 100.0 * double(item.contended) / double(item.acquisitions) : 0.0;
+		const double walked = item.unlocks > 0 ? double(item.waiters_walked) / double(item.unlocks) : 0.0;
+		std::snprintf(line, sizeof(line), "%-32s %12llu %9.1f%% %14.3f %14.1f %9lld ns %9lld ns %10.2f\n",
+					  item.name.c_str(),
+					  static_cast<unsigned long long>(item.acquisitions),
+					  contended,
+					  std::chrono::duration<double, std::milli>(item.total_wait).count(),
+					  std::chrono::duration<double, std::micro>(item.max_wait).count(),
+					  static_cast<long long>(item.hold_percentile(0.5).count()),
+					  static_cast<long long>(item.hold_percentile(0.99).count()),
+					  walked);
+		out << line;
+	}
+}
+
+
+void lock_profiler::reset() {
+	auto& shared = profiles();
+	std::lock_guard lk(shared.m_mtx);
+	for (auto& [name, profile] : shared.m_profiles) {
+		profile->reset();
+	}
+}
+
+
+} // namespace cppjobs
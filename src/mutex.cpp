@@ -2,23 +2,48 @@
 #include <iostream>
 #include <limits>
 #include <stdexcept>
+#include <cppjobs/lock_profiler.hpp>
 #include <cppjobs/mutex.hpp>
 
 
 namespace cppjobs {
 
+mutex::mutex(std::string_view name) {
+#ifdef CPPJOBS_MUTEX_PROFILING
+	m_profile = lock_profile::get(name);
+#else
+	(void)name;
+#endif
+}
+
 mutex::awaitable mutex::operator co_await() {
 	return awaitable{ .m_mutex = this };
 }
 
 bool mutex::try_lock() {
-	awaitable_node* hoped = nullptr;
-	awaitable_node* const tag = reinterpret_cast<awaitable_node*>(std::numeric_limits<uintptr_t>::max());
-	bool locked = m_waiting.compare_exchange_strong(hoped, tag);
-	if (locked) {
-		m_holder = tag;
+	const bool locked = try_acquire();
+#ifdef CPPJOBS_MUTEX_PROFILING
+	if (locked && m_profile != nullptr) {
+		profile_acquired(0, false);
 	}
-	return locked;	
+#endif
+	return locked;
+}
+
+#ifdef CPPJOBS_MUTEX_PROFILING
+void mutex::profile_acquired(int64_t wait_start, bool contended) {
+	m_locked_at = profile_now();
+	m_profile->acquired(contended ? m_locked_at - wait_start : 0, contended);
+}
+
+int64_t mutex::profile_now() {
+	return lock_profile::now();
+}
+#endif
+
+bool mutex::try_acquire() {
+	awaitable_node* hoped = nullptr;
+	return m_waiting.compare_exchange_strong(hoped, locked_tag());
 }
 
 void mutex::token::unlock() {
@@ -28,35 +53,93 @@ void mutex::token::unlock() {
 }
 
 bool mutex::awaitable::await_ready() const {
-	return m_mutex->try_lock();
+#ifdef CPPJOBS_COROUTINE_REGISTRY
+	return false; // await_suspend locks it just as well, and it knows which coroutine becomes the owner.
+#else
+	return m_mutex->try_acquire();
+#endif
 }
 
 mutex::token mutex::awaitable::await_resume() const {
+#ifdef CPPJOBS_MUTEX_PROFILING
+	if (m_mutex->m_profile != nullptr) {
+		m_mutex->profile_acquired(m_wait_start, m_contended);
+	}
+#endif
+#ifdef CPPJOBS_COROUTINE_REGISTRY
+	if (m_record != nullptr) {
+		m_record->resumed();
+	}
+	m_mutex->m_owner.store(m_record != nullptr ? m_record->owner_id() : 0, std::memory_order_relaxed);
+#endif
 	return token{ m_mutex };
 }
 
 void mutex::unlock() {
-	awaitable_node* holder = m_holder;
+#ifdef CPPJOBS_MUTEX_PROFILING
+	// The mutex may be destroyed as soon as it's released, the profile lives on.
+	lock_profile* const profile = m_profile;
+	const int64_t hold_ns = profile != nullptr ? profile_now() - m_locked_at : 0;
+	uint64_t walked = 0;
+#endif
+#ifdef CPPJOBS_COROUTINE_REGISTRY
+	m_owner.store(0, std::memory_order_relaxed);
+#endif
+	awaitable_node* head = locked_tag();
 
-	// If the head of the list (m_waiting) equals holder, nobody is else is waiting.
-	// In this case the mutex is freed by writing nullptr as the holder.
-	const bool nobody_waited = m_waiting.compare_exchange_strong(holder, nullptr);
+	// If the head of the list (m_waiting) is the tag, nobody is waiting.
+	// In this case the mutex is freed by writing nullptr.
+	const bool nobody_waited = m_waiting.compare_exchange_strong(head, nullptr);
 
-	// If somebody was waiting, we have now have the head of the list in holder.
+	// If somebody was waiting, we have now have the head of the list in head.
 	if (!nobody_waited) {
-		if (holder == nullptr) {
+		if (head == nullptr) {
 			throw std::logic_error("mutex is not locked!");
 		}
-		awaitable_node* next_in_line = nullptr;
-		while (holder != m_holder) {
-			next_in_line = holder;
-			holder = holder->m_next;
+		// The node right before the tag has waited the longest.
+		awaitable_node* before = nullptr;
+		awaitable_node* next_in_line = head;
+		while (next_in_line->m_next != locked_tag()) {
+			before = next_in_line;
+			next_in_line = next_in_line->m_next;
+#ifdef CPPJOBS_MUTEX_PROFILING
+			++walked;
+#endif
+		}
+		// Unlink it, the tag keeps the mutex locked for it. Others may be queuing in front of it meanwhile.
+		if (before == nullptr && !m_waiting.compare_exchange_strong(head, locked_tag())) {
+			before = head;
+			while (before->m_next != next_in_line) {
+				before = before->m_next;
+			}
+		}
+		if (before != nullptr) {
+			before->m_next = locked_tag();
 		}
-		// Resume next in line.
 		next_in_line->m_next = nullptr;
-		m_holder = next_in_line;
+#ifdef CPPJOBS_COROUTINE_REGISTRY
+		// The waiters can't be resumed by anyone but us until the next in line is, so their records are safe to update.
+		const coroutine_record* const next_record = static_cast<awaitable*>(next_in_line)->m_record;
+		const uint64_t next_owner = next_record != nullptr ? next_record->owner_id() : 0;
+		m_owner.store(next_owner, std::memory_order_relaxed);
+		for (awaitable_node* waiter = m_waiting.load(); waiter != locked_tag(); waiter = waiter->m_next) {
+			if (coroutine_record* const record = static_cast<awaitable*>(waiter)->m_record) {
+				record->waits_for(next_owner);
+			}
+		}
+#endif
+#ifdef CPPJOBS_MUTEX_PROFILING
+		if (profile != nullptr) {
+			profile->released(hold_ns, walked);
+		}
+#endif
 		next_in_line->resume();
 	}
+#ifdef CPPJOBS_MUTEX_PROFILING
+	else if (profile != nullptr) {
+		profile->released(hold_ns, 0);
+	}
+#endif
 }
 
 bool mutex::_is_locked() const {
@@ -0,0 +1,107 @@
+#include <cppjobs/pipeline.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+
+namespace cppjobs {
+
+
+struct pipeline_base::gate {
+	stage_mode m_mode;
+	std::mutex m_mtx;
+	bool m_busy = false;
+	/// <summary> For in-order gates, the only sequence number allowed in. </summary>
+	size_t m_next = 0;
+	/// <summary> Sequence numbers and tokens, in arrival order. There are never more than max_tokens. </summary>
+	std::vector<std::pair<size_t, std::coroutine_handle<>>> m_waiting;
+};
+
+
+bool pipeline_base::gate_awaitable::await_suspend(std::coroutine_handle<> waiting) const {
+	std::lock_guard lk(m_gate->m_mtx);
+	const bool my_turn = m_gate->m_mode == stage_mode::serial_out_of_order || m_sequence == m_gate->m_next;
+	if (!m_gate->m_busy && my_turn) {
+		m_gate->m_busy = true;
+		return false;
+	}
+	m_gate->m_waiting.emplace_back(m_sequence, waiting);
+	return true;
+}
+
+
+pipeline_base::pipeline_base(std::vector<stage_mode> modes) {
+	for (auto mode : modes) {
+		m_gates.push_back(mode == stage_mode::parallel ? nullptr : std::make_unique<gate>(mode));
+	}
+}
+
+pipeline_base::~pipeline_base() = default;
+
+pipeline_base::gate_awaitable pipeline_base::enter(size_t stage, size_t sequence) {
+	return { m_gates[stage].get(), sequence };
+}
+
+void pipeline_base::leave(size_t stage) {
+	gate* const current = m_gates[stage].get();
+	if (current == nullptr) {
+		return;
+	}
+	std::coroutine_handle<> next = nullptr;
+	{
+		std::lock_guard lk(current->m_mtx);
+		auto& waiting = current->m_waiting;
+		auto it = waiting.begin();
+		if (current->m_mode == stage_mode::serial_in_order) {
+			++current->m_next;
+			it = std::ranges::find(waiting, current->m_next, &std::pair<size_t, std::coroutine_handle<>>::first);
+		}
+		if (it != waiting.end()) {
+			next = it->second; // The gate stays busy, it's handed over.
+			waiting.erase(it);
+		}
+		else {
+			current->m_busy = false;
+		}
+	}
+	if (next) {
+		m_scheduler->queue_for_resume(next);
+	}
+}
+
+void pipeline_base::start(std::shared_ptr<scheduler_base> sched) {
+	if (m_running.exchange(true)) {
+		throw std::logic_error("pipeline is already running");
+	}
+	for (auto& current : m_gates) {
+		if (current) {
+			current->m_next = 0;
+		}
+	}
+	m_scheduler = std::move(sched);
+	m_next_sequence = 0;
+	m_exhausted = false;
+	m_failed = false;
+	m_error = nullptr;
+}
+
+void pipeline_base::finish() {
+	m_scheduler = nullptr;
+	auto error = std::exchange(m_error, nullptr);
+	m_running = false;
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
+
+void pipeline_base::fail(std::exception_ptr error) {
+	std::lock_guard lk(m_error_mtx);
+	if (!m_error) {
+		m_error = std::move(error);
+	}
+	m_failed = true;
+}
+
+
+} // namespace cppjobs
@@ -1,16 +1,26 @@
+#include <string>
 #include <cppjobs/shared_mutex.hpp>
 
 
 namespace cppjobs {
 
 
+shared_mutex::shared_mutex(std::string_view name)
+	: m_outerMutex(name), m_innerMtx(std::string(name) + "/readers") {}
+
 future<shared_mutex::token> shared_mutex::lock() {
+#ifdef CPPJOBS_COROUTINE_REGISTRY
+	co_await act_for_awaiter{}; // The caller holds the lock once this returns, not this coroutine.
+#endif
 	co_await m_outerMutex;
 	co_await m_innerMtx;
 	co_return token{ this };
 }
 
 future<shared_mutex::shared_token> shared_mutex::lock_shared() {
+#ifdef CPPJOBS_COROUTINE_REGISTRY
+	co_await act_for_awaiter{};
+#endif
 	co_await m_outerMutex;
 	auto prev = m_innerCount++;
 	if (prev == 0) {
@@ -0,0 +1,115 @@
+#include <cppjobs/schedulers/strand.hpp>
+#include <cppjobs/frame_arena.hpp>
+
+#include <algorithm>
+#include <exception>
+#include <new>
+
+
+namespace cppjobs {
+
+
+struct strand::drain_task {
+	struct promise_type {
+		drain_task get_return_object() { return { std::coroutine_handle<promise_type>::from_promise(*this) }; }
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		std::suspend_always final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+	};
+	std::coroutine_handle<promise_type> m_handle;
+};
+
+
+struct strand::drain_awaitable {
+	bool await_ready() const noexcept { return false; }
+	bool await_suspend(std::coroutine_handle<> drainer) const {
+		strand* const self = m_strand;
+		if (m_yield) {
+			// Batch is full, let other work run on this worker. We are still the owner of m_running.
+			self->m_underlying->queue_for_resume(drainer);
+			return true;
+		}
+		// The strand may die as soon as it's idle, but only after we're suspended, so it can destroy this frame.
+		auto keep_alive = std::move(self->m_self);
+		self->m_running.store(false);
+		// We are no longer the consumer, so only the producer side of the queue can be inspected.
+		if (!self->m_queue.approx_empty() && !self->m_running.exchange(true)) {
+			self->m_self = std::move(keep_alive);
+			return false;
+		}
+		return true;
+	}
+	void await_resume() const noexcept {}
+	strand* m_strand;
+	bool m_yield;
+};
+
+
+strand::job* strand::make_job(std::coroutine_handle<> handle) {
+	// Workers take these from their thread's frame cache, only threads outside any pool go to the heap.
+	auto* created = new (frame_arena::allocate(sizeof(job))) job;
+	created->m_handle = handle;
+	return created;
+}
+
+void strand::destroy_job(job* destroyed) noexcept {
+	destroyed->~job();
+	frame_arena::deallocate(destroyed, sizeof(job));
+}
+
+
+strand::strand(std::shared_ptr<scheduler_base> underlying, size_t batch_size)
+	: m_underlying(std::move(underlying)), m_batch_size(batch_size > 0 ? batch_size : 1) {
+	m_drainer = drain().m_handle;
+}
+
+strand::~strand() {
+	m_drainer.destroy();
+	while (!m_queue.empty()) {
+		if (job* next = m_queue.pop()) {
+			destroy_job(next);
+		}
+	}
+}
+
+scheduler_metrics strand::metrics() const {
+	scheduler_metrics snapshot;
+	snapshot.resumed = m_resumed.load(std::memory_order_relaxed);
+	snapshot.queued = std::max(snapshot.resumed, m_queued.load(std::memory_order_relaxed));
+	snapshot.queue_length = snapshot.queued - snapshot.resumed;
+	return snapshot;
+}
+
+void strand::queue_for_resume(std::coroutine_handle<> handle) {
+	m_queued.fetch_add(1, std::memory_order_relaxed);
+	m_queue.push(make_job(handle));
+	if (!m_running.exchange(true)) {
+		m_self = shared_from_this();
+		m_underlying->queue_for_resume(m_drainer);
+	}
+}
+
+strand::drain_task strand::drain() {
+	while (true) {
+		size_t count = 0;
+		while (count < m_batch_size) {
+			job* next = m_queue.pop();
+			if (next == nullptr) {
+				if (m_queue.empty()) {
+					break;
+				}
+				continue; // A producer is halfway through a push.
+			}
+			const auto handle = next->m_handle;
+			destroy_job(next);
+			m_resumed.store(m_resumed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			tracer::resume(handle);
+			++count;
+		}
+		co_await drain_awaitable{ this, count == m_batch_size };
+	}
+}
+
+
+} // namespace cppjobs
@@ -0,0 +1,174 @@
+#include <cppjobs/task_graph.hpp>
+
+#include <stdexcept>
+#include <utility>
+
+
+namespace cppjobs {
+
+
+struct task_graph::loop_task {
+	struct promise_type {
+		loop_task get_return_object() { return { std::coroutine_handle<promise_type>::from_promise(*this) }; }
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		std::suspend_always final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { std::terminate(); }
+		static void* operator new(size_t size) { return frame_arena::allocate(size); }
+		static void operator delete(void* ptr, size_t size) { frame_arena::deallocate(ptr, size); }
+	};
+	std::coroutine_handle<promise_type> m_handle;
+};
+
+
+struct task_graph::node_finished {
+	bool await_ready() const noexcept { return false; }
+	void await_suspend(std::coroutine_handle<>) const {
+		// The last node may let the graph be destroyed, along with this frame, so it's counted only after suspending.
+		m_graph->finish_node();
+	}
+	void await_resume() const noexcept {}
+	task_graph* m_graph;
+};
+
+
+struct task_graph::run_finished {
+	bool await_ready() const noexcept { return false; }
+	bool await_suspend(std::coroutine_handle<> waiting) const {
+		m_graph->m_waiting = waiting;
+		return m_graph->m_remaining.fetch_sub(1) != 1;
+	}
+	void await_resume() const noexcept {}
+	task_graph* m_graph;
+};
+
+
+task_graph::~task_graph() {
+	for (auto& current : m_nodes) {
+		if (current->m_loop) {
+			current->m_loop.destroy();
+		}
+	}
+}
+
+void task_graph::precede(node_id before, node_id after) {
+	if (before >= m_nodes.size() || after >= m_nodes.size()) {
+		throw std::out_of_range("task_graph node id out of range");
+	}
+	m_nodes[before]->m_successors.push_back(m_nodes[after].get());
+	++m_nodes[after]->m_predecessors;
+	m_validated = false;
+}
+
+size_t task_graph::size() const {
+	return m_nodes.size();
+}
+
+task_graph::node_id task_graph::add_node(std::function<void()> func, std::function<future<void>()> coro) {
+	auto& added = *m_nodes.emplace_back(std::make_unique<node>());
+	added.m_func = std::move(func);
+	added.m_coro = std::move(coro);
+	added.m_loop = loop(added).m_handle;
+	m_validated = false;
+	return m_nodes.size() - 1;
+}
+
+void task_graph::validate() {
+	// Kahn's algorithm: if repeatedly removing nodes without predecessors doesn't remove all of them, there is a cycle.
+	std::vector<size_t> pending;
+	std::vector<node*> ready;
+	pending.reserve(m_nodes.size());
+	for (auto& current : m_nodes) {
+		current->m_pending = current->m_predecessors;
+		if (current->m_predecessors == 0) {
+			ready.push_back(current.get());
+		}
+	}
+	size_t visited = 0;
+	while (!ready.empty()) {
+		node* const current = ready.back();
+		ready.pop_back();
+		++visited;
+		for (node* successor : current->m_successors) {
+			if (--successor->m_pending == 0) {
+				ready.push_back(successor);
+			}
+		}
+	}
+	if (visited != m_nodes.size()) {
+		throw std::logic_error("task_graph has a cycle");
+	}
+	m_validated = true;
+}
+
+future<void> task_graph::run(std::shared_ptr<scheduler_base> sched) {
+	if (m_running.exchange(true)) {
+		throw std::logic_error("task_graph is already running");
+	}
+	if (!m_validated) {
+		try {
+			validate();
+		}
+		catch (...) {
+			m_running = false;
+			throw;
+		}
+	}
+	m_scheduler = std::move(sched);
+	m_failed = false;
+	m_error = nullptr;
+	m_remaining = m_nodes.size() + 1;
+	for (auto& current : m_nodes) {
+		current->m_pending.store(current->m_predecessors, std::memory_order_relaxed);
+	}
+	for (auto& current : m_nodes) {
+		if (current->m_predecessors == 0) {
+			m_scheduler->queue_for_resume(current->m_loop);
+		}
+	}
+	co_await run_finished{ this };
+
+	m_scheduler = nullptr;
+	auto error = std::exchange(m_error, nullptr);
+	m_running = false;
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
+
+task_graph::loop_task task_graph::loop(node& self) {
+	while (true) {
+		if (!m_failed.load(std::memory_order_relaxed)) {
+			try {
+				if (self.m_coro) {
+					co_await self.m_coro();
+				}
+				else {
+					self.m_func();
+				}
+			}
+			catch (...) {
+				std::lock_guard lk(m_error_mtx);
+				if (!m_error) {
+					m_error = std::current_exception();
+				}
+				m_failed = true;
+			}
+		}
+		for (node* successor : self.m_successors) {
+			if (successor->m_pending.fetch_sub(1) == 1) {
+				m_scheduler->queue_for_resume(successor->m_loop);
+			}
+		}
+		co_await node_finished{ this };
+	}
+}
+
+void task_graph::finish_node() {
+	if (m_remaining.fetch_sub(1) == 1) {
+		m_waiting.resume();
+	}
+}
+
+
+} // namespace cppjobs
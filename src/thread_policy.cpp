@@ -0,0 +1,73 @@
+#include <cppjobs/thread_policy.hpp>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <cerrno>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+
+namespace cppjobs {
+
+
+std::error_code set_thread_affinity(const std::vector<size_t>& cpus) {
+	if (cpus.empty()) {
+		return {};
+	}
+#ifdef __linux__
+	cpu_set_t mask;
+	CPU_ZERO(&mask);
+	for (auto cpu : cpus) {
+		if (cpu >= CPU_SETSIZE) {
+			return std::make_error_code(std::errc::invalid_argument);
+		}
+		CPU_SET(cpu, &mask);
+	}
+	if (int result = pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask); result != 0) {
+		return { result, std::system_category() };
+	}
+	return {};
+#else
+	return std::make_error_code(std::errc::function_not_supported);
+#endif
+}
+
+
+std::error_code set_thread_policy(const thread_policy& policy) {
+	if (policy.policy == scheduling_policy::inherit && !policy.nice) {
+		return {};
+	}
+#ifdef __linux__
+	if (policy.policy != scheduling_policy::inherit) {
+		int native = SCHED_OTHER;
+		switch (policy.policy) {
+			case scheduling_policy::normal: native = SCHED_OTHER; break;
+			case scheduling_policy::batch: native = SCHED_BATCH; break;
+			case scheduling_policy::idle: native = SCHED_IDLE; break;
+			case scheduling_policy::fifo: native = SCHED_FIFO; break;
+			case scheduling_policy::round_robin: native = SCHED_RR; break;
+			default: break;
+		}
+		const bool realtime = native == SCHED_FIFO || native == SCHED_RR;
+		sched_param param{};
+		param.sched_priority = realtime ? policy.priority : 0;
+		if (int result = pthread_setschedparam(pthread_self(), native, &param); result != 0) {
+			return { result, std::system_category() };
+		}
+	}
+	if (policy.nice) {
+		// On Linux, niceness is a per-thread attribute when addressed by thread id.
+		if (setpriority(PRIO_PROCESS, gettid(), *policy.nice) != 0) {
+			return { errno, std::system_category() };
+		}
+	}
+	return {};
+#else
+	return std::make_error_code(std::errc::function_not_supported);
+#endif
+}
+
+
+} // namespace cppjobs
@@ -0,0 +1,795 @@
+#include <algorithm>
+#include <deque>
+#include <latch>
+#include <limits>
+#include <memory>
+#include <new>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#include <cppjobs/frame_arena.hpp>
+#include <cppjobs/schedulers/thread_pool_scheduler.hpp>
+
+
+namespace cppjobs {
+
+
+struct thread_pool_scheduler::work_queue {
+	void push(std::coroutine_handle<> handle) {
+		std::lock_guard lk(m_mtx);
+		m_items.push_back(handle);
+		update_size();
+	}
+	void push(std::span<const std::coroutine_handle<>> handles) {
+		std::lock_guard lk(m_mtx);
+		m_items.insert(m_items.end(), handles.begin(), handles.end());
+		update_size();
+	}
+	/// <summary> Oldest item, for the owner. </summary>
+	std::coroutine_handle<> pop() {
+		if (m_size.load(std::memory_order_relaxed) == 0) {
+			return nullptr;
+		}
+		std::lock_guard lk(m_mtx);
+		if (m_items.empty()) {
+			return nullptr;
+		}
+		auto handle = m_items.front();
+		m_items.pop_front();
+		m_size.store(m_items.size(), std::memory_order_relaxed);
+		return handle;
+	}
+	/// <summary> Newest item, for thieves. </summary>
+	std::coroutine_handle<> steal() {
+		if (m_size.load(std::memory_order_relaxed) == 0) {
+			return nullptr;
+		}
+		std::lock_guard lk(m_mtx);
+		if (m_items.empty()) {
+			return nullptr;
+		}
+		auto handle = m_items.back();
+		m_items.pop_back();
+		m_size.store(m_items.size(), std::memory_order_relaxed);
+		return handle;
+	}
+	size_t size() const {
+		return m_size.load(std::memory_order_relaxed);
+	}
+	size_t max_size() const {
+		return m_max_size.load(std::memory_order_relaxed);
+	}
+
+private:
+	void update_size() {
+		m_size.store(m_items.size(), std::memory_order_relaxed);
+		if (m_items.size() > m_max_size.load(std::memory_order_relaxed)) {
+			m_max_size.store(m_items.size(), std::memory_order_relaxed);
+		}
+	}
+
+private:
+	std::mutex m_mtx;
+	std::deque<std::coroutine_handle<>> m_items;
+	std::atomic_size_t m_size = 0;
+	/// <summary> High-water mark of m_size, written under the lock. </summary>
+	std::atomic_size_t m_max_size = 0;
+};
+
+
+/// <summary>
+/// Queue of chunks of handles. Producers are lock-free, they push a chunk onto a stack with a single CAS.
+/// Consumers serialize on a mutex, and move the stack over to a list in FIFO order when the list runs dry.
+/// </summary>
+struct thread_pool_scheduler::injection_queue {
+	struct chunk {
+		chunk* m_next = nullptr;
+		size_t m_size = 0;
+
+		std::coroutine_handle<>* handles() { return reinterpret_cast<std::coroutine_handle<>*>(this + 1); }
+
+		static chunk* create(std::span<const std::coroutine_handle<>> handles) {
+			static_assert(alignof(chunk) >= alignof(std::coroutine_handle<>));
+			auto* created = new (::operator new(sizeof(chunk) + handles.size_bytes())) chunk{ nullptr, handles.size() };
+			std::ranges::uninitialized_copy(handles, std::span(created->handles(), handles.size()));
+			return created;
+		}
+		static void destroy(chunk* destroyed) {
+			destroyed->~chunk();
+			::operator delete(destroyed);
+		}
+	};
+
+	injection_queue() = default;
+	injection_queue(const injection_queue&) = delete;
+	injection_queue& operator=(const injection_queue&) = delete;
+	~injection_queue() {
+		for (chunk* list : { m_ready.load(), m_pushed.load() }) {
+			while (list != nullptr) {
+				chunk::destroy(std::exchange(list, list->m_next));
+			}
+		}
+	}
+
+	void push(chunk* added) {
+		chunk* head = m_pushed.load(std::memory_order_relaxed);
+		do {
+			added->m_next = head;
+		} while (!m_pushed.compare_exchange_weak(head, added, std::memory_order_release, std::memory_order_relaxed));
+	}
+	/// <summary> Oldest chunks, as a list, with max_handles handles at most unless the first chunk is larger. </summary>
+	chunk* pop(size_t max_handles) {
+		if (empty()) {
+			return nullptr;
+		}
+		std::lock_guard lk(m_mtx);
+		chunk* ready = m_ready.load(std::memory_order_relaxed);
+		if (ready == nullptr) {
+			// The stack is newest first, reversing it gives FIFO order.
+			for (chunk* pushed = m_pushed.exchange(nullptr, std::memory_order_acquire); pushed != nullptr;) {
+				chunk* const next = pushed->m_next;
+				pushed->m_next = ready;
+				ready = std::exchange(pushed, next);
+			}
+			if (ready == nullptr) {
+				return nullptr;
+			}
+		}
+		chunk* const first = ready;
+		chunk* last = ready;
+		for (size_t count = last->m_size; last->m_next != nullptr && count + last->m_next->m_size <= max_handles;) {
+			last = last->m_next;
+			count += last->m_size;
+		}
+		m_ready.store(last->m_next, std::memory_order_relaxed);
+		last->m_next = nullptr;
+		return first;
+	}
+	bool empty() const {
+		return m_ready.load(std::memory_order_relaxed) == nullptr && m_pushed.load(std::memory_order_relaxed) == nullptr;
+	}
+
+private:
+	std::atomic<chunk*> m_pushed = nullptr;
+	std::mutex m_mtx;
+	std::atomic<chunk*> m_ready = nullptr;
+};
+
+
+struct thread_pool_scheduler::node {
+	numa_node m_info;
+	frame_arena* m_arena = nullptr;
+	injection_queue m_injection;
+	std::vector<worker*> m_workers;
+	/// <summary> The other nodes, closest first. </summary>
+	std::vector<node*> m_remotes;
+	/// <summary> Number of handles pushed to m_injection. </summary>
+	std::atomic_uint64_t m_injected = 0;
+};
+
+
+struct thread_pool_scheduler::worker {
+	thread_pool_scheduler* m_pool = nullptr;
+	size_t m_index = 0;
+	node* m_node = nullptr;
+	std::vector<size_t> m_cpus;
+	work_queue m_queue;
+	size_t m_next_victim = 0;
+	/// <summary> The LIFO slot: the handle queued last, runs before the queue. </summary>
+	std::atomic<void*> m_next = nullptr;
+	/// <summary> How many handles in a row came from the LIFO slot. </summary>
+	size_t m_next_streak = 0;
+	/// <summary> Bumped per resumed handle by the thread running the worker, so thieves can tell whether it is stuck on one. </summary>
+	std::atomic_uint64_t m_resumes = 0;
+
+	/// <summary> The resume count of another worker with a full LIFO slot, and since when this worker has seen it unchanged. </summary>
+	struct sighting {
+		uint64_t m_resumes = std::numeric_limits<uint64_t>::max();
+		int64_t m_since = 0;
+	};
+	/// <summary> By worker index, only this worker's thread touches them. </summary>
+	std::vector<sighting> m_sightings;
+	/// <summary> When a LIFO slot seen by the last find_work may be stolen, in steady_clock nanoseconds, or zero. </summary>
+	int64_t m_steal_next_at = 0;
+
+	/// <summary>
+	/// Metrics that only the thread running the worker writes, so they're bumped without atomic read-modify-writes.
+	/// They have a cache line of their own, so that reading them doesn't disturb the fields above.
+	/// </summary>
+	struct alignas(64) counters {
+		std::atomic_uint64_t m_queued = 0;
+		std::atomic_uint64_t m_stolen = 0;
+		std::atomic_int64_t m_idle_ns = 0;
+		/// <summary> When the worker started waiting for work, in steady_clock nanoseconds, or zero if it's not waiting. </summary>
+		std::atomic_int64_t m_idle_since = 0;
+	} m_counters;
+};
+
+
+thread_local thread_pool_scheduler::worker* thread_pool_scheduler::tls_worker = nullptr;
+thread_local thread_pool_scheduler* thread_pool_scheduler::tls_pool = nullptr;
+thread_local thread_pool_scheduler::batch* thread_pool_scheduler::tls_batch = nullptr;
+
+
+static void bump(std::atomic_uint64_t& counter, uint64_t amount = 1) {
+	counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+static int64_t steady_ns() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+// Large enough to make the CAS per chunk negligible, small enough to spread a batch over the workers.
+static constexpr size_t injection_chunk_size = 64;
+
+// Thieves leave a LIFO slot alone until its owner has been on the same handle for this long, it's likely to get to it sooner.
+static constexpr int64_t next_steal_grace_ns = 5'000;
+
+
+static void cpu_relax() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	_mm_pause();
+#elif defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	asm volatile("yield");
+#endif
+}
+
+
+thread_pool_scheduler::thread_pool_scheduler(thread_pool_options options)
+	: m_idle(options.idle), m_lifo_limit(options.lifo_limit), m_idle_timeout(options.idle_timeout), m_policy(options.policy) {
+	auto topology = options.topology.empty() ? system_topology() : std::move(options.topology);
+	if (!options.cpus.empty()) {
+		for (auto& info : topology) {
+			std::erase_if(info.cpus, [&options](size_t cpu) { return std::ranges::find(options.cpus, cpu) == options.cpus.end(); });
+		}
+		std::erase_if(topology, [](const numa_node& info) { return info.cpus.empty(); });
+		if (topology.empty()) {
+			throw std::invalid_argument("none of the CPUs requested for the thread pool are available");
+		}
+	}
+	const size_t num_cpus = std::accumulate(topology.begin(), topology.end(), size_t(0), [](size_t sum, const numa_node& info) {
+		return sum + info.cpus.size();
+	});
+	const size_t num_threads = options.num_threads > 0 ? options.num_threads : std::max(num_cpus, size_t(1));
+
+	// Spread workers in proportion to the CPUs in each node.
+	std::vector<size_t> counts(topology.size(), 0);
+	for (size_t i = 0; i < num_threads; ++i) {
+		size_t target = 0;
+		double lowest = std::numeric_limits<double>::max();
+		for (size_t k = 0; k < topology.size(); ++k) {
+			const double load = double(counts[k]) / double(std::max(topology[k].cpus.size(), size_t(1)));
+			if (load < lowest) {
+				lowest = load;
+				target = k;
+			}
+		}
+		++counts[target];
+	}
+
+	for (size_t k = 0; k < topology.size(); ++k) {
+		if (counts[k] == 0) {
+			continue;
+		}
+		auto& current = *m_nodes.emplace_back(std::make_unique<node>());
+		current.m_info = std::move(topology[k]);
+		current.m_arena = &frame_arena::for_node(current.m_info.id);
+		for (size_t i = 0; i < counts[k]; ++i) {
+			auto& added = *m_workers.emplace_back(std::make_unique<worker>());
+			added.m_pool = this;
+			added.m_index = m_workers.size() - 1;
+			added.m_node = &current;
+			switch (options.pinning) {
+				case thread_pinning::none: break;
+				case thread_pinning::node: added.m_cpus = current.m_info.cpus; break;
+				case thread_pinning::cpu: added.m_cpus = { current.m_info.cpus[i % current.m_info.cpus.size()] }; break;
+			}
+			current.m_workers.push_back(&added);
+		}
+	}
+
+	for (auto& current : m_nodes) {
+		for (auto& remote : m_nodes) {
+			if (remote != current) {
+				current->m_remotes.push_back(remote.get());
+			}
+		}
+		const auto& distances = current->m_info.distances;
+		std::ranges::stable_sort(current->m_remotes, {}, [&distances](const node* remote) {
+			const size_t id = remote->m_info.id;
+			return id < distances.size() ? distances[id] : std::numeric_limits<size_t>::max();
+		});
+	}
+
+	for (auto& slot : m_workers) {
+		slot->m_sightings.resize(m_workers.size());
+	}
+
+	m_max_threads = std::max(options.max_threads, m_workers.size());
+	m_num_threads = m_workers.size();
+
+	// Pinning to nodes is only best effort where it's not supported, but explicit requests must be honored.
+	const bool strict = !options.cpus.empty() || options.pinning == thread_pinning::cpu;
+	std::vector<std::error_code> errors(m_workers.size());
+	std::latch configured(ptrdiff_t(m_workers.size()));
+	for (size_t i = 0; i < m_workers.size(); ++i) {
+		std::thread([this, slot = m_workers[i].get(), &error = errors[i], &configured, strict] {
+			error = set_thread_affinity(slot->m_cpus);
+			if (error == std::errc::function_not_supported && !strict) {
+				error = {};
+			}
+			if (!error) {
+				error = set_thread_policy(m_policy);
+			}
+			configured.count_down();
+			thread_main(slot);
+		}).detach();
+	}
+	configured.wait();
+
+	for (const auto& error : errors) {
+		if (error) {
+			shutdown();
+			throw std::system_error(error, "failed to configure thread pool worker");
+		}
+	}
+}
+
+thread_pool_scheduler::~thread_pool_scheduler() {
+	shutdown();
+}
+
+void thread_pool_scheduler::shutdown() {
+	m_stop = true;
+	m_epoch.fetch_add(1);
+	m_epoch.notify_all();
+
+	// The last reference may be released by a coroutine on one of our threads. It will return as soon as the coroutine does.
+	const bool own_thread = tls_pool == this;
+	if (own_thread) {
+		tls_pool = nullptr;
+		tls_worker = nullptr;
+		frame_arena::bind_thread(nullptr);
+	}
+	std::unique_lock lk(m_threads_mtx);
+	m_spare_cv.notify_all();
+	m_exit_cv.wait(lk, [this, own_thread] { return m_num_threads == (own_thread ? 1 : 0); });
+}
+
+size_t thread_pool_scheduler::num_workers() const {
+	return m_workers.size();
+}
+
+size_t thread_pool_scheduler::num_threads() const {
+	std::lock_guard lk(m_threads_mtx);
+	return m_num_threads;
+}
+
+size_t thread_pool_scheduler::num_nodes() const {
+	return m_nodes.size();
+}
+
+ptrdiff_t thread_pool_scheduler::current_worker() const {
+	return tls_worker != nullptr && tls_worker->m_pool == this ? ptrdiff_t(tls_worker->m_index) : -1;
+}
+
+bool thread_pool_scheduler::needs_work() const {
+	// The LIFO slot doesn't count, its handle is the owner's to run next, not the thieves'.
+	const worker* const local = tls_worker;
+	return local == nullptr || local->m_pool != this || local->m_queue.size() == 0;
+}
+
+scheduler_metrics thread_pool_scheduler::metrics() const {
+	scheduler_metrics snapshot;
+	const int64_t now = steady_ns();
+	for (const auto& current : m_nodes) {
+		snapshot.queued_injected += current->m_injected.load(std::memory_order_relaxed);
+	}
+	int64_t idle_ns = 0;
+	for (const auto& slot : m_workers) {
+		const auto& counters = slot->m_counters;
+		snapshot.queued_local += counters.m_queued.load(std::memory_order_relaxed);
+		snapshot.stolen += counters.m_stolen.load(std::memory_order_relaxed);
+		snapshot.resumed += slot->m_resumes.load(std::memory_order_relaxed);
+		idle_ns += counters.m_idle_ns.load(std::memory_order_relaxed);
+		if (const int64_t since = counters.m_idle_since.load(std::memory_order_relaxed); since != 0) {
+			idle_ns += std::max<int64_t>(0, now - since);
+		}
+		const size_t length = slot->m_queue.size() + (slot->m_next.load(std::memory_order_relaxed) != nullptr);
+		snapshot.queue_length += length;
+		snapshot.max_queue_length = std::max({ snapshot.max_queue_length, slot->m_queue.max_size(), length });
+	}
+	snapshot.queued = snapshot.queued_local + snapshot.queued_injected;
+	const auto elapsed = std::chrono::steady_clock::now() - m_created;
+	snapshot.idle = std::chrono::nanoseconds(idle_ns);
+	snapshot.busy = std::max(std::chrono::nanoseconds(0), std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed) * int64_t(m_workers.size()) - snapshot.idle);
+	snapshot.workers = m_workers.size();
+	return snapshot;
+}
+
+void thread_pool_scheduler::queue_for_resume(std::coroutine_handle<> handle) {
+	if (tls_batch != nullptr && &tls_batch->m_pool == this) {
+		tls_batch->m_handles.push_back(handle);
+		return;
+	}
+	worker* const local = tls_worker;
+	if (local != nullptr && local->m_pool == this) {
+		bump(local->m_counters.m_queued);
+		if (m_lifo_limit == 0) {
+			local->m_queue.push(handle);
+		}
+		else if (void* displaced = local->m_next.exchange(handle.address())) {
+			local->m_queue.push(std::coroutine_handle<>::from_address(displaced));
+		}
+		wake(1);
+	}
+	else {
+		submit({ &handle, 1 });
+	}
+}
+
+void thread_pool_scheduler::submit(std::span<const std::coroutine_handle<>> handles) {
+	if (handles.empty()) {
+		return;
+	}
+	worker* const local = tls_worker;
+	if (local != nullptr && local->m_pool == this) {
+		bump(local->m_counters.m_queued, handles.size());
+		local->m_queue.push(handles);
+		wake(std::min(handles.size(), m_workers.size()));
+		return;
+	}
+	inject(handles);
+}
+
+void thread_pool_scheduler::queue_for_resume_batch(std::span<const std::coroutine_handle<>> handles) {
+	if (tls_batch != nullptr && &tls_batch->m_pool == this) {
+		tls_batch->m_handles.insert(tls_batch->m_handles.end(), handles.begin(), handles.end());
+		return;
+	}
+	// Thieves would take a large batch out of the local queue one handle at a time.
+	handles.size() >= injection_chunk_size ? inject(handles) : submit(handles);
+}
+
+void thread_pool_scheduler::inject(std::span<const std::coroutine_handle<>> handles) {
+	const size_t num_chunks = (handles.size() + injection_chunk_size - 1) / injection_chunk_size;
+	for (size_t offset = 0; offset < handles.size(); offset += injection_chunk_size) {
+		auto* const chunk = injection_queue::chunk::create(handles.subspan(offset, std::min(injection_chunk_size, handles.size() - offset)));
+		const size_t target = m_next_node.fetch_add(1, std::memory_order_relaxed) % m_nodes.size();
+		m_nodes[target]->m_injected.fetch_add(chunk->m_size, std::memory_order_relaxed);
+		m_nodes[target]->m_injection.push(chunk);
+	}
+	wake(std::min(num_chunks, m_workers.size()));
+}
+
+thread_pool_scheduler::batch::batch(thread_pool_scheduler& pool)
+	: m_pool(pool), m_scheduler(pool.shared_from_this()), m_previous(tls_batch), m_arena(frame_arena::bound_arena()) {
+	std::swap(m_scheduler, tls_scheduler);
+	tls_batch = this;
+	// Outside threads would get frames from the global heap one by one.
+	if (m_arena == nullptr) {
+		const size_t target = pool.m_next_node.load(std::memory_order_relaxed) % pool.m_nodes.size();
+		frame_arena::bind_thread(pool.m_nodes[target]->m_arena);
+	}
+}
+
+thread_pool_scheduler::batch::~batch() {
+	frame_arena::bind_thread(m_arena);
+	tls_batch = m_previous;
+	std::swap(m_scheduler, tls_scheduler);
+	m_pool.submit(m_handles);
+}
+
+void thread_pool_scheduler::thread_main(worker* slot) {
+	tls_pool = this;
+	while (true) {
+		if (slot == nullptr) {
+			slot = wait_for_slot();
+			if (slot == nullptr) {
+				break;
+			}
+			set_thread_affinity(slot->m_cpus); // Best effort, there is nobody to report to.
+		}
+		run(*slot);
+		if (tls_pool != this) {
+			return; // The pool has been destroyed from within a coroutine, don't touch anything.
+		}
+		// A blocking region that ended may have given this thread another worker.
+		slot = std::exchange(tls_worker, nullptr);
+	}
+	tls_pool = nullptr;
+	frame_arena::bind_thread(nullptr);
+
+	std::lock_guard lk(m_threads_mtx);
+	--m_num_threads;
+	m_exit_cv.notify_all(); // Under the lock, the pool may be gone as soon as it's released.
+}
+
+void thread_pool_scheduler::run(worker& self) {
+	tls_worker = &self;
+	frame_arena::bind_thread(self.m_node->m_arena);
+
+	while (true) {
+		auto handle = find_work(self);
+		if (!handle) {
+			if (m_stop.load()) {
+				break;
+			}
+			// Announce first, then look once more: whoever queues work from now on sees us and wakes us.
+			m_idle_workers.fetch_add(1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			const uint32_t epoch = m_epoch.load();
+			handle = find_work(self);
+			if (!handle && !m_stop.load()) {
+				const int64_t idle_since = steady_ns();
+				self.m_counters.m_idle_since.store(idle_since, std::memory_order_relaxed);
+				wait_for_work(epoch, self.m_steal_next_at);
+				self.m_counters.m_idle_since.store(0, std::memory_order_relaxed);
+				self.m_counters.m_idle_ns.store(self.m_counters.m_idle_ns.load(std::memory_order_relaxed) + steady_ns() - idle_since, std::memory_order_relaxed);
+			}
+			m_idle_workers.fetch_sub(1, std::memory_order_relaxed);
+			if (!handle) {
+				continue;
+			}
+		}
+		bump(self.m_resumes);
+		tracer::resume(handle);
+		if (tls_worker != &self) {
+			return; // Either the queue was handed to another thread or the pool is gone.
+		}
+	}
+
+	tls_worker = nullptr;
+}
+
+bool thread_pool_scheduler::hand_off(worker& slot) {
+	std::unique_lock lk(m_threads_mtx);
+	const bool spare_ready = m_num_spares > m_orphans.size();
+	if (!spare_ready && m_num_threads >= m_max_threads) {
+		return false;
+	}
+	// The worker waits as an orphan until some thread takes it, which may be its own if the region ends first.
+	m_orphans.push_back(&slot);
+	if (spare_ready) {
+		m_spare_cv.notify_one();
+		return true;
+	}
+	++m_num_threads;
+	lk.unlock();
+	try {
+		std::thread([this] {
+			set_thread_policy(m_policy);
+			thread_main(nullptr);
+		}).detach();
+		return true;
+	}
+	catch (...) {
+		lk.lock();
+		--m_num_threads;
+		m_exit_cv.notify_all();
+		// A thread that became a spare meanwhile may have taken it already.
+		return std::erase(m_orphans, &slot) == 0;
+	}
+}
+
+thread_pool_scheduler::worker* thread_pool_scheduler::reclaim(worker& slot) {
+	std::lock_guard lk(m_threads_mtx);
+	if (m_orphans.empty()) {
+		return nullptr;
+	}
+	auto it = std::ranges::find(m_orphans, &slot);
+	if (it == m_orphans.end()) {
+		it = std::prev(m_orphans.end());
+	}
+	worker* const taken = *it;
+	m_orphans.erase(it);
+	return taken;
+}
+
+thread_pool_scheduler::worker* thread_pool_scheduler::wait_for_slot() {
+	std::unique_lock lk(m_threads_mtx);
+	++m_num_spares;
+	m_spare_cv.wait_for(lk, m_idle_timeout, [this] { return !m_orphans.empty() || m_stop.load(); });
+	--m_num_spares;
+	if (m_orphans.empty()) {
+		return nullptr;
+	}
+	worker* const slot = m_orphans.back();
+	m_orphans.pop_back();
+	return slot;
+}
+
+std::coroutine_handle<> thread_pool_scheduler::find_work(worker& self) {
+	// A pair of coroutines waking each other would keep the LIFO slot busy forever, hence the limit.
+	if (self.m_next_streak < m_lifo_limit) {
+		if (void* next = self.m_next.exchange(nullptr)) {
+			++self.m_next_streak;
+			return std::coroutine_handle<>::from_address(next);
+		}
+	}
+	self.m_next_streak = 0;
+	if (auto handle = self.m_queue.pop()) {
+		return handle;
+	}
+	if (void* next = self.m_next.exchange(nullptr)) {
+		return std::coroutine_handle<>::from_address(next);
+	}
+	if (auto handle = take_injected(self, *self.m_node)) {
+		return handle;
+	}
+	if (auto handle = steal(self, *self.m_node)) {
+		return handle;
+	}
+	for (node* remote : self.m_node->m_remotes) {
+		if (auto handle = take_injected(self, *remote)) {
+			return handle;
+		}
+		if (auto handle = steal(self, *remote)) {
+			return handle;
+		}
+	}
+	self.m_steal_next_at = 0;
+	if (auto handle = steal_next(self, *self.m_node)) {
+		return handle;
+	}
+	for (node* remote : self.m_node->m_remotes) {
+		if (auto handle = steal_next(self, *remote)) {
+			return handle;
+		}
+	}
+	return nullptr;
+}
+
+std::coroutine_handle<> thread_pool_scheduler::take_injected(worker& self, node& source) {
+	auto* chunk = source.m_injection.pop(injection_chunk_size);
+	if (chunk == nullptr) {
+		return nullptr;
+	}
+	// Run the first handle, the rest go to the local queue where other workers can steal them.
+	const auto first = chunk->handles()[0];
+	size_t more = source.m_injection.empty() ? 0 : 1;
+	for (size_t skip = 1; chunk != nullptr; skip = 0) {
+		self.m_queue.push(std::span(chunk->handles() + skip, chunk->m_size - skip));
+		more += chunk->m_size - skip;
+		injection_queue::chunk::destroy(std::exchange(chunk, chunk->m_next));
+	}
+	if (more > 0) {
+		wake(std::min(more, m_workers.size() - 1));
+	}
+	return first;
+}
+
+std::coroutine_handle<> thread_pool_scheduler::steal(worker& self, const node& victim_node) {
+	const auto& victims = victim_node.m_workers;
+	const size_t start = self.m_next_victim++;
+	for (size_t i = 0; i < victims.size(); ++i) {
+		worker* const victim = victims[(start + i) % victims.size()];
+		if (victim == &self) {
+			continue;
+		}
+		if (auto handle = victim->m_queue.steal()) {
+			bump(self.m_counters.m_stolen);
+			return handle;
+		}
+	}
+	return nullptr;
+}
+
+std::coroutine_handle<> thread_pool_scheduler::steal_next(worker& self, const node& victim_node) {
+	for (worker* victim : victim_node.m_workers) {
+		if (victim == &self || victim->m_next.load(std::memory_order_relaxed) == nullptr) {
+			continue;
+		}
+		// Only take the slot if the owner has been busy with the same handle since an earlier pass.
+		// Nothing waits here, the idle loop comes back when the grace is over.
+		const uint64_t resumes = victim->m_resumes.load(std::memory_order_relaxed);
+		const int64_t now = steady_ns();
+		auto& seen = self.m_sightings[victim->m_index];
+		if (seen.m_resumes != resumes) {
+			seen = { resumes, now };
+		}
+		if (const int64_t ready_at = seen.m_since + next_steal_grace_ns; now < ready_at) {
+			self.m_steal_next_at = self.m_steal_next_at == 0 ? ready_at : std::min(self.m_steal_next_at, ready_at);
+			continue;
+		}
+		if (void* next = victim->m_next.exchange(nullptr)) {
+			bump(self.m_counters.m_stolen);
+			return std::coroutine_handle<>::from_address(next);
+		}
+	}
+	return nullptr;
+}
+
+blocking_region::blocking_region() {
+	auto* const slot = thread_pool_scheduler::tls_worker;
+	if (slot == nullptr || slot->m_pool->m_max_threads <= slot->m_pool->m_workers.size()) {
+		return;
+	}
+	// Detach first so that nothing this thread does from now on goes to the worker's queue.
+	thread_pool_scheduler::tls_worker = nullptr;
+	m_compensated = slot->m_pool->hand_off(*slot);
+	if (!m_compensated) {
+		thread_pool_scheduler::tls_worker = slot;
+		return;
+	}
+	m_pool = slot->m_pool;
+	m_slot = slot;
+}
+
+blocking_region::~blocking_region() {
+	// Only on the thread that entered the region, the coroutine may have moved on to a worker since.
+	if (!m_compensated || thread_pool_scheduler::tls_worker != nullptr || thread_pool_scheduler::tls_pool != m_pool) {
+		return;
+	}
+	// Otherwise the rest of the coroutine would run on top of all the workers.
+	auto* const slot = m_pool->reclaim(*m_slot);
+	if (slot == nullptr) {
+		return;
+	}
+	if (slot != m_slot) {
+		set_thread_affinity(slot->m_cpus); // Best effort, there is nobody to report to.
+	}
+	thread_pool_scheduler::tls_worker = slot;
+	frame_arena::bind_thread(slot->m_node->m_arena);
+}
+
+void thread_pool_scheduler::wait_for_work(uint32_t epoch, int64_t retry_at) {
+	using clock = std::chrono::steady_clock;
+	const auto start = clock::now();
+	// A LIFO slot to steal cuts the wait short.
+	const auto deadline = retry_at != 0 ? clock::time_point(std::chrono::nanoseconds(retry_at)) : clock::time_point::max();
+
+	for (size_t i = 0; m_idle.spin.count() > 0; ++i) {
+		if (m_epoch.load(std::memory_order_relaxed) != epoch) {
+			return;
+		}
+		if (i % 64 == 63) {
+			const auto now = clock::now();
+			if (now >= deadline) {
+				return;
+			}
+			if (now - start >= m_idle.spin) {
+				break;
+			}
+		}
+		cpu_relax();
+	}
+	while (m_idle.yield.count() > 0 && clock::now() - start < m_idle.spin + m_idle.yield) {
+		if (m_epoch.load(std::memory_order_relaxed) != epoch || clock::now() >= deadline) {
+			return;
+		}
+		std::this_thread::yield();
+	}
+	// Parking has no timeout, sleep until the slot may be stolen instead.
+	if (retry_at != 0) {
+		std::this_thread::sleep_until(deadline);
+		return;
+	}
+
+	// Either the waker sees us in m_sleeping, or we see its new epoch and don't block.
+	++m_sleeping;
+	m_epoch.wait(epoch);
+	--m_sleeping;
+}
+
+void thread_pool_scheduler::wake(size_t count) {
+	// Pairs with the fence of a worker going idle: either it finds the work just queued, or we see it here.
+	// Busy pools skip the shared epoch, so pushing to the local queue touches nothing the other workers write.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (m_idle_workers.load(std::memory_order_relaxed) == 0) {
+		return;
+	}
+	m_epoch.fetch_add(1);
+	for (size_t i = 0; i < count && m_sleeping.load() > 0; ++i) {
+		m_epoch.notify_one();
+	}
+}
+
+
+} // namespace cppjobs
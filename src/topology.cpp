@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <thread>
+#include <cppjobs/topology.hpp>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+
+namespace cppjobs {
+
+
+static std::vector<size_t> allowed_cpus(std::vector<size_t> cpus) {
+#ifdef __linux__
+	cpu_set_t mask;
+	CPU_ZERO(&mask);
+	if (sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+		std::erase_if(cpus, [&mask](size_t cpu) { return cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &mask); });
+	}
+#endif
+	return cpus;
+}
+
+
+std::vector<size_t> parse_cpu_list(const char* list) {
+	std::vector<size_t> cpus;
+	const char* it = list;
+	while (*it != '\0') {
+		char* end;
+		const size_t first = std::strtoul(it, &end, 10);
+		if (end == it) {
+			break;
+		}
+		size_t last = first;
+		it = end;
+		if (*it == '-') {
+			++it;
+			last = std::strtoul(it, &end, 10);
+			if (end == it) {
+				break;
+			}
+			it = end;
+		}
+		for (size_t cpu = first; cpu <= last; ++cpu) {
+			cpus.push_back(cpu);
+		}
+		while (*it == ',' || *it == '\n' || *it == ' ') {
+			++it;
+		}
+	}
+	return cpus;
+}
+
+
+std::vector<numa_node> system_topology() {
+	std::vector<numa_node> nodes;
+
+	namespace fs = std::filesystem;
+	std::error_code ec;
+	const fs::path root = "/sys/devices/system/node";
+	std::vector<size_t> online;
+	if (std::ifstream file(root / "online"); file) {
+		std::string list;
+		std::getline(file, list);
+		online = parse_cpu_list(list.c_str()); // Same format as CPU lists.
+	}
+	for (fs::directory_iterator it(root, ec), end; !ec && it != end; it.increment(ec)) {
+		const std::string name = it->path().filename().string();
+		if (name.size() <= 4 || name.compare(0, 4, "node") != 0 || !std::all_of(name.begin() + 4, name.end(), ::isdigit)) {
+			continue;
+		}
+		std::ifstream file(it->path() / "cpulist");
+		std::string list;
+		if (!std::getline(file, list)) {
+			continue;
+		}
+		numa_node node{ .id = std::stoul(name.substr(4)), .cpus = allowed_cpus(parse_cpu_list(list.c_str())) };
+		if (std::ifstream distance_file(it->path() / "distance"); distance_file) {
+			// One distance per online node, in the order of node ids.
+			for (size_t index = 0, distance; index < online.size() && distance_file >> distance; ++index) {
+				node.distances.resize(std::max(node.distances.size(), online[index] + 1), std::numeric_limits<size_t>::max());
+				node.distances[online[index]] = distance;
+			}
+		}
+		if (!node.cpus.empty()) {
+			nodes.push_back(std::move(node));
+		}
+	}
+
+	if (nodes.empty()) {
+		numa_node node;
+		for (size_t cpu = 0; cpu < std::max(1u, std::thread::hardware_concurrency()); ++cpu) {
+			node.cpus.push_back(cpu);
+		}
+		if (auto allowed = allowed_cpus(node.cpus); !allowed.empty()) {
+			node.cpus = std::move(allowed);
+		}
+		nodes.push_back(std::move(node));
+	}
+	std::ranges::sort(nodes, {}, &numa_node::id);
+	return nodes;
+}
+
+
+} // namespace cppjobs
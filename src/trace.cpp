@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cppjobs/trace.hpp>
+
+
+namespace cppjobs {
+
+
+struct tracer::registry {
+	std::mutex m_mtx;
+	std::vector<std::unique_ptr<buffer>> m_buffers;
+	size_t m_next_thread = 0;
+	/// <summary> A timestamp and the time it was taken, to convert timestamps to nanoseconds. </summary>
+	int64_t m_origin_ticks = timestamp();
+	std::chrono::steady_clock::time_point m_origin_time = std::chrono::steady_clock::now();
+};
+
+
+struct tracer::thread_guard {
+	buffer* m_buffer = nullptr;
+	~thread_guard() {
+		if (m_buffer != nullptr) {
+			tls_buffer = nullptr; // Later events of the thread are dropped, see attach.
+			m_buffer->m_retired.store(true, std::memory_order_release);
+		}
+	}
+};
+
+
+thread_local tracer::thread_guard tracer::tls_guard;
+
+
+namespace {
+	const char* event_name(trace_event event) {
+		switch (event) {
+			case trace_event::create: return "create";
+			case trace_event::start: return "start";
+			case trace_event::queue: return "queue";
+			case trace_event::resume: return "resume";
+			case trace_event::suspend: return "suspend";
+			case trace_event::finish: return "finish";
+		}
+		return "unknown";
+	}
+} // namespace
+
+
+tracer::registry& tracer::buffers() {
+	static registry* instance = new registry; // Never freed, threads may record while static objects are destroyed.
+	return *instance;
+}
+
+
+tracer::buffer* tracer::attach() {
+	if (tls_guard.m_buffer != nullptr) {
+		return nullptr; // The thread is exiting and its buffer is retired.
+	}
+	auto& shared = buffers();
+	auto created = std::make_unique<buffer>();
+	std::lock_guard lk(shared.m_mtx);
+	created->m_thread = shared.m_next_thread++;
+	tls_buffer = created.get();
+	tls_guard.m_buffer = created.get();
+	shared.m_buffers.push_back(std::move(created));
+	return tls_buffer;
+}
+
+
+void tracer::write_chrome_trace(std::ostream& out) {
+	struct entry {
+		int64_t m_time;
+		const void* m_coroutine;
+		trace_event m_event;
+		size_t m_thread;
+	};
+	std::vector<entry> entries;
+
+	auto& shared = buffers();
+	{
+		std::lock_guard lk(shared.m_mtx);
+		for (auto& source : shared.m_buffers) {
+			const bool retired = source->m_retired.load(std::memory_order_acquire);
+			const uint64_t head = source->m_head.load(std::memory_order_acquire);
+			const uint64_t first = std::max(source->m_tail, head > buffer_capacity ? head - buffer_capacity : 0);
+			const size_t begin = entries.size();
+			for (uint64_t index = first; index < head; ++index) {
+				const slot& item = source->m_slots[index & (buffer_capacity - 1)];
+				entries.push_back({ item.m_time.load(std::memory_order_relaxed),
+									item.m_coroutine.load(std::memory_order_relaxed),
+									item.m_event.load(std::memory_order_relaxed),
+									source->m_thread });
+			}
+			// The owner may have overwritten the oldest slots while they were copied.
+			const uint64_t now = source->m_head.load(std::memory_order_acquire);
+			if (now > buffer_capacity && now - buffer_capacity > first) {
+				const size_t overwritten = std::min<uint64_t>(now - buffer_capacity - first, head - first);
+				entries.erase(entries.begin() + begin, entries.begin() + begin + overwritten);
+			}
+			source->m_tail = head;
+			if (retired) {
+				source.reset();
+			}
+		}
+		std::erase(shared.m_buffers, nullptr);
+	}
+
+	int64_t origin = std::numeric_limits<int64_t>::max();
+	for (const auto& item : entries) {
+		origin = std::min(origin, item.m_time);
+	}
+	// The longer the interval, the better the rate. The registry is created with the first event.
+	const auto min_interval = std::chrono::milliseconds(10);
+	std::this_thread::sleep_until(shared.m_origin_time + min_interval);
+	const int64_t ticks = timestamp() - shared.m_origin_ticks;
+	const double elapsed_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - shared.m_origin_time).count();
+	const double us_per_tick = ticks > 0 ? elapsed_ns / double(ticks) / 1000.0 : 0.001;
+
+	// Runs are duration events on the thread. The lifetime of a coroutine is an async span
+	// with the frame address as id, so that its events line up in a row no matter which thread they come from.
+	out << "{\"traceEvents\":[";
+	bool first = true;
+	char line[256];
+	for (const auto& item : entries) {
+		const double ts = double(item.m_time - origin) * us_per_tick;
+		const char* format = nullptr;
+		switch (item.m_event) {
+			case trace_event::create:
+				format = "{\"ph\":\"b\",\"cat\":\"coroutine\",\"name\":\"coroutine\",\"id\":\"%p\",\"pid\":1,\"tid\":%zu,\"ts\":%.3f}";
+				break;
+			case trace_event::finish:
+				format = "{\"ph\":\"e\",\"cat\":\"coroutine\",\"name\":\"coroutine\",\"id\":\"%p\",\"pid\":1,\"tid\":%zu,\"ts\":%.3f}";
+				break;
+			case trace_event::resume:
+				format = "{\"ph\":\"B\",\"name\":\"run\",\"args\":{\"coroutine\":\"%p\"},\"pid\":1,\"tid\":%zu,\"ts\":%.3f}";
+				break;
+			case trace_event::suspend:
+				format = "{\"ph\":\"E\",\"args\":{\"coroutine\":\"%p\"},\"pid\":1,\"tid\":%zu,\"ts\":%.3f}";
+				break;
+			default:
+				break;
+		}
+		if (format != nullptr) {
+			std::snprintf(line, sizeof(line), format, item.m_coroutine, item.m_thread, ts);
+		}
+		else {
+			std::snprintf(line, sizeof(line),
+						  "{\"ph\":\"n\",\"cat\":\"coroutine\",\"name\":\"%s\",\"id\":\"%p\",\"pid\":1,\"tid\":%zu,\"ts\":%.3f}",
+						  event_name(item.m_event), item.m_coroutine, item.m_thread, ts);
+		}
+		out << (first ? "\n" : ",\n") << line;
+		first = false;
+	}
+	out << "\n]}\n";
+}
+
+
+void tracer::clear() {
+	auto& shared = buffers();
+	std::lock_guard lk(shared.m_mtx);
+	for (auto& source : shared.m_buffers) {
+		source->m_tail = source->m_head.load(std::memory_order_acquire);
+		if (source->m_retired.load(std::memory_order_acquire)) {
+			source.reset();
+		}
+	}
+	std::erase(shared.m_buffers, nullptr);
+}
+
+
+} // namespace cppjobs
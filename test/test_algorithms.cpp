@@ -0,0 +1,124 @@
+#include <catch.hpp>
+#include <cppjobs/algorithms.hpp>
+#include <cppjobs/schedulers/immediate_scheduler.hpp>
+#include <cppjobs/schedulers/thread_pool_scheduler.hpp>
+
+#include <numeric>
+#include <random>
+
+using namespace cppjobs;
+
+
+static std::vector<int> random_values(size_t count, int max) {
+	std::mt19937 rng(count);
+	std::uniform_int_distribution<int> dist(0, max);
+	std::vector<int> values(count);
+	std::ranges::generate(values, [&] { return dist(rng); });
+	return values;
+}
+
+
+static std::shared_ptr<scheduler> make_pool() {
+	return std::make_shared<thread_pool_scheduler>(thread_pool_options{ .num_threads = 4, .pinning = thread_pinning::none });
+}
+
+
+TEST_CASE("Parallel sort", "[Algorithms]") {
+	auto sched = make_pool();
+	for (size_t count : { 0, 1, 1000, 100000 }) {
+		auto values = random_values(count, 1000);
+		auto expected = values;
+		std::ranges::sort(expected);
+		algorithms::sort(sched, values).get();
+		REQUIRE(values == expected);
+	}
+}
+
+
+TEST_CASE("Parallel sort is stable", "[Algorithms]") {
+	auto sched = make_pool();
+	std::vector<std::pair<int, int>> values;
+	for (auto key : random_values(50000, 10)) {
+		values.emplace_back(key, int(values.size()));
+	}
+	auto expected = values;
+	std::ranges::stable_sort(expected, {}, &std::pair<int, int>::first);
+	algorithms::sort(sched, values, [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; }).get();
+	REQUIRE(values == expected);
+}
+
+
+TEST_CASE("Parallel sort on serial scheduler", "[Algorithms]") {
+	auto sched = std::make_shared<immediate_scheduler>();
+	auto values = random_values(10000, 1000);
+	auto expected = values;
+	std::ranges::sort(expected, std::greater<>{});
+	algorithms::sort(sched, values, std::greater<>{}).get();
+	REQUIRE(values == expected);
+}
+
+
+TEST_CASE("Parallel transform", "[Algorithms]") {
+	auto sched = make_pool();
+	auto values = random_values(100000, 1000);
+	std::vector<long long> squares(values.size());
+	algorithms::transform(sched, values, squares.begin(), [](int value) { return (long long)value * value; }).get();
+	REQUIRE(std::ranges::equal(squares, values | std::views::transform([](int value) { return (long long)value * value; })));
+}
+
+
+TEST_CASE("Parallel scan", "[Algorithms]") {
+	auto sched = make_pool();
+	for (size_t count : { 0, 1, 1000, 300000 }) {
+		const auto values = random_values(count, 100);
+
+		std::vector<int> expected(count);
+		std::vector<int> result(count);
+		std::inclusive_scan(values.begin(), values.end(), expected.begin());
+		algorithms::inclusive_scan(sched, values, result.begin()).get();
+		REQUIRE(result == expected);
+
+		std::exclusive_scan(values.begin(), values.end(), expected.begin(), 7);
+		algorithms::exclusive_scan(sched, values, result.begin(), 7).get();
+		REQUIRE(result == expected);
+
+		// In place.
+		auto in_place = values;
+		std::inclusive_scan(values.begin(), values.end(), expected.begin());
+		algorithms::inclusive_scan(sched, in_place, in_place.begin()).get();
+		REQUIRE(in_place == expected);
+	}
+}
+
+
+TEST_CASE("Parallel scan keeps order", "[Algorithms]") {
+	// Composition of affine maps x -> a*x + b is associative, but not commutative.
+	using affine = std::pair<uint64_t, uint64_t>;
+	constexpr uint64_t modulus = 1'000'000'007;
+	const auto compose = [](const affine& first, const affine& second) {
+		return affine{ second.first * first.first % modulus, (second.first * first.second + second.second) % modulus };
+	};
+	std::vector<affine> maps;
+	for (auto value : random_values(200000, 1000)) {
+		maps.emplace_back(value + 1, value / 3);
+	}
+	std::vector<affine> expected(maps.size());
+	std::vector<affine> result(maps.size());
+	std::inclusive_scan(maps.begin(), maps.end(), expected.begin(), compose);
+	algorithms::inclusive_scan(make_pool(), maps, result.begin(), compose).get();
+	REQUIRE(result == expected);
+}
+
+
+TEST_CASE("Parallel partition", "[Algorithms]") {
+	auto sched = make_pool();
+	for (size_t count : { 0, 1, 1000, 100000 }) {
+		auto values = random_values(count, 1000);
+		auto expected = values;
+		auto is_even = [](int value) { return value % 2 == 0; };
+		const auto expected_point = std::stable_partition(expected.begin(), expected.end(), is_even);
+		const auto point = algorithms::partition(sched, values, is_even).get();
+		REQUIRE(values == expected);
+		REQUIRE(point - values.begin() == expected_point - expected.begin());
+	}
+}
@@ -0,0 +1,90 @@
+#include <catch.hpp>
+#include <cppjobs/async_scope.hpp>
+#include <cppjobs/schedulers/debug_scheduler.hpp>
+#include <cppjobs/schedulers/immediate_scheduler.hpp>
+#include <cppjobs/schedulers/thread_pool_scheduler.hpp>
+
+#include <atomic>
+#include <numeric>
+
+using namespace cppjobs;
+
+
+static future<size_t> sum_by_reference(std::shared_ptr<scheduler_base> sched) {
+	std::vector<size_t> parts(100, 0);
+	async_scope scope(sched);
+	for (size_t i = 0; i < parts.size(); ++i) {
+		scope.spawn([](size_t& part, size_t value) { part = value; }, std::ref(parts[i]), i);
+	}
+	co_await scope.join();
+	co_return std::accumulate(parts.begin(), parts.end(), size_t(0));
+}
+
+
+TEST_CASE("Async scope children by reference", "[Async scope]") {
+	auto sched = std::make_shared<thread_pool_scheduler>(thread_pool_options{ .num_threads = 4, .pinning = thread_pinning::none });
+	REQUIRE(sched->schedule(sum_by_reference, sched).get() == 99 * 100 / 2);
+}
+
+
+TEST_CASE("Async scope on serial scheduler", "[Async scope]") {
+	auto sched = std::make_shared<debug_scheduler<immediate_scheduler>>();
+	REQUIRE(sched->schedule(sum_by_reference, sched).get() == 99 * 100 / 2);
+	REQUIRE(sched->resume_count() == 101);
+}
+
+
+static future<void> nested(std::shared_ptr<scheduler_base> sched, std::atomic_int& count) {
+	async_scope scope(sched);
+	for (int i = 0; i < 10; ++i) {
+		scope.spawn([&scope, &count]() {
+			++count;
+			scope.spawn([&count]() -> future<void> {
+				++count;
+				co_return;
+			});
+		});
+	}
+	co_await scope.join();
+	const int first = count;
+	// Reuse after join.
+	scope.spawn([&count] { ++count; });
+	co_await scope.join();
+	REQUIRE(first == 20);
+}
+
+
+TEST_CASE("Async scope nested spawn and reuse", "[Async scope]") {
+	auto sched = std::make_shared<thread_pool_scheduler>(thread_pool_options{ .num_threads = 4, .pinning = thread_pinning::none });
+	std::atomic_int count = 0;
+	sched->schedule(nested, sched, std::ref(count)).get();
+	REQUIRE(count == 21);
+}
+
+
+static future<int> failing(std::shared_ptr<scheduler_base> sched, std::atomic_int& finished) {
+	async_scope scope(sched);
+	for (int i = 0; i < 20; ++i) {
+		scope.spawn([&finished, i] {
+			++finished;
+			if (i == 7) {
+				throw std::runtime_error("child failed");
+			}
+		});
+	}
+	try {
+		co_await scope.join();
+	}
+	catch (std::runtime_error&) {
+		co_return -1;
+	}
+	co_return 0;
+}
+
+
+TEST_CASE("Async scope exception", "[Async scope]") {
+	auto sched = std::make_shared<thread_pool_scheduler>(thread_pool_options{ .num_threads = 4, .pinning = thread_pinning::none });
+	std::atomic_int finished = 0;
+	REQUIRE(sched->schedule(failing, sched, std::ref(finished)).get() == -1);
+	REQUIRE(finished == 20);
+}
@@ -0,0 +1,232 @@
+#include <catch.hpp>
+#include <cppjobs/coroutine_registry.hpp>
+#include <cppjobs/future.hpp>
+#include <cppjobs/mutex.hpp>
+#include <cppjobs/shared_mutex.hpp>
+#include <algorithm>
+#include <array>
+#include <sstream>
+#include <string>
+
+using namespace cppjobs;
+
+
+TEST_CASE("Coroutine registry find cycles", "[Coroutine registry]") {
+	std::vector<coroutine_info> graph(6);
+	const std::array<std::pair<uint64_t, uint64_t>, 6> edges = { {
+		{ 1, 2 }, { 2, 3 }, { 3, 1 }, // Cycle.
+		{ 4, 1 }, // Waits for the cycle, but isn't part of it.
+		{ 5, 0 }, // Unknown holder.
+		{ 6, 7 }, // Finished coroutine.
+	} };
+	for (size_t i = 0; i < edges.size(); ++i) {
+		graph[i].id = edges[i].first;
+		graph[i].waits_for = edges[i].second;
+		graph[i].kind = await_kind::mutex;
+	}
+	auto cycles = coroutine_registry::find_cycles(graph);
+	REQUIRE(cycles.size() == 1);
+	std::ranges::sort(cycles[0]);
+	REQUIRE(cycles[0] == std::vector<uint64_t>{ 1, 2, 3 });
+
+	graph[2].kind = await_kind::none;
+	REQUIRE(coroutine_registry::find_cycles(graph).empty());
+}
+
+
+TEST_CASE("Coroutine registry label", "[Coroutine registry]") {
+	auto labeled = []() -> future<int> {
+		co_await label_coroutine{ "test/labeled" };
+		co_return 1;
+	}();
+	labeled.start();
+	REQUIRE(labeled.get() == 1);
+	if constexpr (!coroutine_registry::enabled) {
+		REQUIRE(coroutine_registry::snapshot().empty());
+	}
+}
+
+
+#ifdef CPPJOBS_COROUTINE_REGISTRY
+namespace {
+	struct gate {
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> handle) noexcept { m_handle = handle; }
+		void await_resume() const noexcept {}
+		std::coroutine_handle<> m_handle;
+	};
+
+	const coroutine_info* find_label(const std::vector<coroutine_info>& coroutines, const std::string& label) {
+		const auto it = std::ranges::find(coroutines, label, &coroutine_info::label);
+		return it != coroutines.end() ? &*it : nullptr;
+	}
+} // namespace
+
+
+TEST_CASE("Coroutine registry future edges", "[Coroutine registry]") {
+	gate release;
+	auto child = [](gate& release) -> future<int> {
+		co_await label_coroutine{ "test/child" };
+		co_await release;
+		co_return 1;
+	};
+	auto parent = [](future<int> child) -> future<int> {
+		co_await label_coroutine{ "test/parent" };
+		co_return co_await child;
+	};
+	{
+		auto fut = parent(child(release));
+		fut.start();
+
+		const auto coroutines = coroutine_registry::snapshot();
+		const auto parent_info = find_label(coroutines, "test/parent");
+		const auto child_info = find_label(coroutines, "test/child");
+		REQUIRE(parent_info != nullptr);
+		REQUIRE(child_info != nullptr);
+		REQUIRE(parent_info->kind == await_kind::future);
+		REQUIRE(parent_info->waits_for == child_info->id);
+		REQUIRE(child_info->kind == await_kind::none);
+
+		release.m_handle.resume();
+		REQUIRE(fut.get() == 1);
+	}
+	REQUIRE(find_label(coroutine_registry::snapshot(), "test/child") == nullptr);
+}
+
+
+TEST_CASE("Coroutine registry deadlock", "[Coroutine registry]") {
+	mutex first;
+	mutex second;
+	gate release;
+	auto lock_first_second = [](mutex& first, mutex& second, gate& release) -> future<void> {
+		co_await label_coroutine{ "test/first-second" };
+		co_await first;
+		co_await release;
+		co_await second;
+		second.unlock(); // The first is unlocked by the test to break the deadlock.
+	};
+	auto lock_second_first = [](mutex& first, mutex& second) -> future<void> {
+		co_await label_coroutine{ "test/second-first" };
+		co_await second;
+		co_await first;
+		first.unlock();
+		second.unlock();
+	};
+	auto a = lock_first_second(first, second, release);
+	a.start();
+	auto b = lock_second_first(first, second);
+	b.start();
+	release.m_handle.resume();
+
+	const auto coroutines = coroutine_registry::snapshot();
+	const auto a_info = find_label(coroutines, "test/first-second");
+	const auto b_info = find_label(coroutines, "test/second-first");
+	REQUIRE(a_info != nullptr);
+	REQUIRE(b_info != nullptr);
+	REQUIRE(a_info->kind == await_kind::mutex);
+	REQUIRE(a_info->object == &second);
+	REQUIRE(a_info->waits_for == b_info->id);
+	REQUIRE(b_info->object == &first);
+	REQUIRE(b_info->waits_for == a_info->id);
+	const auto cycles = coroutine_registry::find_cycles(coroutines);
+	REQUIRE(cycles.size() == 1);
+	REQUIRE(cycles[0].size() == 2);
+
+	std::stringstream dump;
+	coroutine_registry::dump(dump);
+	REQUIRE(dump.str().find("deadlock:") != std::string::npos);
+	REQUIRE(dump.str().find("test/first-second") != std::string::npos);
+
+	first.unlock();
+	a.get();
+	b.get();
+	REQUIRE(!first._is_locked());
+	REQUIRE(!second._is_locked());
+}
+
+
+TEST_CASE("Coroutine registry mutex hand-off", "[Coroutine registry]") {
+	mutex mtx;
+	auto hold = [](mutex& mtx, gate& release, std::string_view label) -> future<void> {
+		co_await label_coroutine{ label };
+		co_await mtx;
+		co_await release;
+		mtx.unlock();
+	};
+	gate holder_release;
+	gate first_release;
+	gate second_release;
+	auto holder = hold(mtx, holder_release, "test/holder");
+	holder.start();
+	auto first = hold(mtx, first_release, "test/first");
+	first.start();
+	auto second = hold(mtx, second_release, "test/second");
+	second.start();
+
+	auto coroutines = coroutine_registry::snapshot();
+	const uint64_t holder_id = find_label(coroutines, "test/holder")->id;
+	const uint64_t first_id = find_label(coroutines, "test/first")->id;
+	REQUIRE(find_label(coroutines, "test/first")->waits_for == holder_id);
+	REQUIRE(find_label(coroutines, "test/second")->waits_for == holder_id);
+
+	// The second one is still queued, its edge follows the mutex to the first one.
+	holder_release.m_handle.resume();
+	holder.get();
+	coroutines = coroutine_registry::snapshot();
+	REQUIRE(find_label(coroutines, "test/first")->kind == await_kind::none);
+	REQUIRE(find_label(coroutines, "test/second")->waits_for == first_id);
+
+	first_release.m_handle.resume();
+	first.get();
+	second_release.m_handle.resume();
+	second.get();
+	REQUIRE(!mtx._is_locked());
+}
+
+
+TEST_CASE("Coroutine registry reader-writer deadlock", "[Coroutine registry]") {
+	mutex mtx;
+	shared_mutex smtx;
+	gate release;
+	auto reader = [](mutex& mtx, shared_mutex& smtx, gate& release) -> future<void> {
+		co_await label_coroutine{ "test/reader" };
+		co_await shared(smtx);
+		co_await release;
+		co_await mtx;
+		mtx.unlock();
+		smtx.unlock_shared();
+	};
+	auto writer = [](mutex& mtx, shared_mutex& smtx) -> future<void> {
+		co_await label_coroutine{ "test/writer" };
+		co_await mtx; // Unlocked by the test to break the deadlock.
+		co_await unique(smtx);
+		smtx.unlock();
+	};
+	auto a = reader(mtx, smtx, release);
+	a.start();
+	auto b = writer(mtx, smtx);
+	b.start();
+	release.m_handle.resume();
+
+	// The writer waits for shared_mutex's lock coroutine, which waits for the reader holding the shared lock.
+	const auto coroutines = coroutine_registry::snapshot();
+	const auto a_info = find_label(coroutines, "test/reader");
+	const auto b_info = find_label(coroutines, "test/writer");
+	REQUIRE(a_info != nullptr);
+	REQUIRE(b_info != nullptr);
+	REQUIRE(a_info->kind == await_kind::mutex);
+	REQUIRE(a_info->waits_for == b_info->id);
+	REQUIRE(b_info->kind == await_kind::future);
+	const auto cycles = coroutine_registry::find_cycles(coroutines);
+	REQUIRE(cycles.size() == 1);
+	REQUIRE(cycles[0].size() == 3);
+	REQUIRE(std::ranges::find(cycles[0], a_info->id) != cycles[0].end());
+	REQUIRE(std::ranges::find(cycles[0], b_info->id) != cycles[0].end());
+
+	mtx.unlock();
+	a.get();
+	b.get();
+	REQUIRE(smtx.try_lock());
+	smtx.unlock();
+}
+#endif
@@ -0,0 +1,61 @@
+#include <catch.hpp>
+#include <cppjobs/frame_accounting.hpp>
+#include <cppjobs/future.hpp>
+#include <algorithm>
+#include <sstream>
+#include <string_view>
+#include <vector>
+
+using namespace cppjobs;
+
+
+static future<int> large_frame(int value) {
+	volatile char buffer[2048];
+	buffer[value % sizeof(buffer)] = char(value);
+	co_await std::suspend_never{};
+	co_return buffer[value % sizeof(buffer)];
+}
+
+
+static const frame_site_stats* find_function(const frame_stats& stats, std::string_view name) {
+	const auto it = std::ranges::find_if(stats.sites, [&](const frame_site_stats& site) {
+		return std::string_view(site.function).find(name) != std::string_view::npos;
+	});
+	return it != stats.sites.end() ? &*it : nullptr;
+}
+
+
+TEST_CASE("Frame accounting by function", "[Frame accounting]") {
+	const auto before = frame_accounting::snapshot();
+	std::vector<future<int>> frames;
+	for (int i = 0; i < 100; ++i) {
+		frames.push_back(large_frame(i));
+	}
+	const auto during = frame_accounting::snapshot();
+	frames.clear();
+	const auto after = frame_accounting::snapshot();
+
+	if constexpr (!frame_accounting::enabled) {
+		REQUIRE(during.sites.empty());
+		REQUIRE(during.allocations == 0);
+		return;
+	}
+	const auto site = find_function(during, "large_frame");
+	REQUIRE(site != nullptr);
+	REQUIRE(site->frame_size >= 2048);
+	REQUIRE(site->live_frames == 100);
+	REQUIRE(site->live_bytes == 100 * site->frame_size);
+	REQUIRE(std::string_view(site->file).ends_with("test_frame_accounting.cpp"));
+	REQUIRE(during.allocations - before.allocations == 100);
+	REQUIRE(during.live_bytes - before.live_bytes == 100 * site->frame_size);
+
+	const auto released = find_function(after, "large_frame");
+	REQUIRE(released->live_frames == 0);
+	REQUIRE(released->live_bytes == 0);
+	REQUIRE(released->allocations == 100);
+	REQUIRE(after.live_bytes == before.live_bytes);
+
+	std::stringstream report;
+	frame_accounting::report(report);
+	REQUIRE(report.str().find("large_frame") != std::string::npos);
+}
@@ -1,6 +1,11 @@
 #include <catch.hpp>
+#include <cppjobs/expected.hpp>
 #include <cppjobs/future.hpp>
+#include <atomic>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <system_error>
 #include <thread>
 
 using namespace cppjobs;
@@ -192,4 +197,107 @@ TEST_CASE("Promise destroyed share abandon", "[Future]") {
 		REQUIRE(weak.lock());
 	}
 	REQUIRE(!weak.lock());
-}
\ No newline at end of file
+}
+
+TEST_CASE("Future then", "[Future]") {
+	SECTION("Finishes later") {
+		std::atomic_int result = 0;
+		std::atomic_bool called = false;
+		auto fut = switch_thread_coro();
+		std::move(fut).then([&](future<int> ready) {
+			result = ready.get() + 1;
+			called = true;
+		});
+		REQUIRE(!fut.valid());
+		while (!called) {
+			std::this_thread::yield();
+		}
+		REQUIRE(result == 43);
+	}
+	SECTION("Finished already") {
+		auto fut = simple_coro();
+		fut.get();
+		int result = 0;
+		std::move(fut).then([&result](future<int> ready) { result = ready.get(); });
+		REQUIRE(result == 42);
+	}
+	SECTION("Move-only result") {
+		auto make = []() -> future<std::unique_ptr<std::string>> {
+			co_return std::make_unique<std::string>("moved");
+		};
+		std::unique_ptr<std::string> result;
+		make().then([&result](future<std::unique_ptr<std::string>> ready) { result = ready.get(); });
+		REQUIRE(result != nullptr);
+		REQUIRE(*result == "moved");
+	}
+	SECTION("Shared") {
+		auto make = []() -> future<std::string> {
+			co_return std::string(64, 'x');
+		};
+		auto shared = make().share();
+		std::string first;
+		std::string second;
+		shared.then([&first](shared_future<std::string> ready) { first = ready.get(); });
+		shared.then([&second](shared_future<std::string> ready) { second = ready.get(); });
+		REQUIRE(first == std::string(64, 'x'));
+		REQUIRE(second == first);
+		REQUIRE(shared.get() == first);
+	}
+	SECTION("Void") {
+		bool called = false;
+		void_coro().then([&called](future<void> ready) {
+			ready.get();
+			called = true;
+		});
+		REQUIRE(called);
+	}
+	SECTION("Exception") {
+		auto throwing = []() -> future<int> {
+			throw std::runtime_error("failed");
+			co_return 0;
+		};
+		bool caught = false;
+		throwing().then([&caught](future<int> ready) {
+			try {
+				ready.get();
+			}
+			catch (std::runtime_error&) {
+				caught = true;
+			}
+		});
+		REQUIRE(caught);
+	}
+}
+
+
+TEST_CASE("Future expected", "[Future]") {
+	auto parse = [](int input) -> future<expected<int, std::errc>> {
+		if (input < 0) {
+			co_return unexpected(std::errc::invalid_argument);
+		}
+		co_return input * 2;
+	};
+	SECTION("Value") {
+		auto result = parse(21).get();
+		REQUIRE(result.has_value());
+		REQUIRE(*result == 42);
+	}
+	SECTION("Error") {
+		auto result = parse(-1).get();
+		REQUIRE(!result);
+		REQUIRE(result.error() == std::errc::invalid_argument);
+		REQUIRE(result.value_or(7) == 7);
+		REQUIRE_THROWS_AS(result.value(), bad_expected_access<std::errc>);
+	}
+	SECTION("Awaited") {
+		auto forward = [](future<expected<int, std::errc>> inner) -> future<expected<int, std::errc>> {
+			auto result = co_await inner;
+			if (!result) {
+				co_return unexpected(result.error());
+			}
+			co_return *result + 1;
+		};
+		REQUIRE(*forward(parse(1)).get() == 3);
+		REQUIRE(forward(parse(-1)).get().error() == std::errc::invalid_argument);
+	}
+}
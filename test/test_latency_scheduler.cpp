@@ -0,0 +1,149 @@
+#include <catch.hpp>
+#include <cppjobs/latency_histogram.hpp>
+#include <cppjobs/schedulers/latency_scheduler.hpp>
+#include <cppjobs/schedulers/strand.hpp>
+#include <cppjobs/schedulers/thread_pool_scheduler.hpp>
+#include <chrono>
+#include <thread>
+
+using namespace cppjobs;
+
+
+static void spin(std::chrono::microseconds duration) {
+	const auto until = std::chrono::steady_clock::now() + duration;
+	while (std::chrono::steady_clock::now() < until) {
+	}
+}
+
+
+// The task finishes, and get returns, before the probe records how long the task ran.
+template <class Scheduler>
+static void wait_for_samples(const Scheduler& sched, uint64_t count) {
+	const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+	while (sched.latencies().execution.count < count && std::chrono::steady_clock::now() < deadline) {
+		std::this_thread::yield();
+	}
+}
+
+
+TEST_CASE("Latency histogram buckets", "[Latency]") {
+	for (int64_t value : { 0, 1, 7, 8, 9, 15, 16, 17, 100, 1000, 123456, 987654321 }) {
+		const size_t bucket = latency_distribution::bucket_of(value);
+		REQUIRE(value <= latency_distribution::bucket_upper(bucket));
+		if (bucket > 0) {
+			REQUIRE(value > latency_distribution::bucket_upper(bucket - 1));
+		}
+		REQUIRE(latency_distribution::bucket_upper(bucket) - value <= value / int64_t(latency_distribution::sub_buckets));
+	}
+	REQUIRE(latency_distribution::bucket_of(int64_t(1) << 50) == latency_distribution::num_buckets - 1);
+}
+
+
+TEST_CASE("Latency histogram percentiles", "[Latency]") {
+	latency_histogram histogram;
+	for (int64_t value = 1; value <= 1000; ++value) {
+		histogram.record(value * 1000);
+	}
+	std::thread other([&] { histogram.record(5'000'000); });
+	other.join();
+
+	const auto snapshot = histogram.snapshot();
+	REQUIRE(snapshot.count == 1001);
+	REQUIRE(snapshot.max == std::chrono::milliseconds(5));
+	const auto p50 = snapshot.percentile(0.5).count();
+	REQUIRE(p50 >= 500'000);
+	REQUIRE(p50 <= 500'000 * 9 / 8);
+	const auto p99 = snapshot.percentile(0.99).count();
+	REQUIRE(p99 >= 990'000);
+	REQUIRE(p99 <= 990'000 * 9 / 8);
+	REQUIRE(snapshot.percentile(1.0) == std::chrono::milliseconds(5));
+
+	histogram.reset();
+	REQUIRE(histogram.snapshot().count == 0);
+}
+
+
+TEST_CASE("Latency scheduler execution vs queue delay", "[Latency]") {
+	thread_pool_options options;
+	options.num_threads = 1;
+	auto sched = std::make_shared<latency_scheduler<thread_pool_scheduler>>(options);
+
+	// One worker: the slow tasks run long, and the others queue up behind them.
+	std::vector<future<void>> tasks;
+	for (int i = 0; i < 4; ++i) {
+		tasks.push_back(sched->schedule([] { spin(std::chrono::microseconds(2000)); }));
+		tasks.back().start();
+	}
+	for (auto& task : tasks) {
+		task.get();
+	}
+	wait_for_samples(*sched, 4);
+
+	const auto summary = sched->latencies();
+	REQUIRE(summary.queue_delay.count == 4);
+	REQUIRE(summary.execution.count == 4);
+	REQUIRE(summary.execution.percentile(0.5) >= std::chrono::microseconds(2000));
+	REQUIRE(summary.queue_delay.max >= std::chrono::microseconds(4000));
+
+	sched->reset_latencies();
+	REQUIRE(sched->latencies().execution.count == 0);
+}
+
+
+static future<int> slice(std::chrono::microseconds duration) {
+	spin(duration);
+	co_return 1;
+}
+
+
+TEST_CASE("Latency scheduler tags", "[Latency]") {
+	auto pool = std::make_shared<thread_pool_scheduler>();
+	auto sched = std::make_shared<latency_scheduler<strand>>(pool);
+	auto slow = sched->tagged("slow");
+	auto fast = sched->tagged("fast");
+	REQUIRE(sched->tagged("slow") != slow);
+
+	std::vector<future<int>> tasks;
+	for (int i = 0; i < 3; ++i) {
+		tasks.push_back(slow->schedule(slice, std::chrono::microseconds(1000)));
+		tasks.push_back(fast->schedule(slice, std::chrono::microseconds(0)));
+		tasks.push_back(sched->schedule(slice, std::chrono::microseconds(0)));
+	}
+	int sum = 0;
+	for (auto& task : tasks) {
+		sum += task.get();
+	}
+	REQUIRE(sum == 9);
+	wait_for_samples(*sched, 9);
+
+	const auto by_tag = sched->latencies_by_tag();
+	REQUIRE(by_tag.size() == 3);
+	REQUIRE(by_tag[0].tag == "");
+	REQUIRE(by_tag[1].tag == "fast");
+	REQUIRE(by_tag[2].tag == "slow");
+	for (const auto& item : by_tag) {
+		REQUIRE(item.execution.count == 3);
+		REQUIRE(item.queue_delay.count == 3);
+	}
+	REQUIRE(by_tag[2].execution.percentile(0.0) >= std::chrono::microseconds(1000));
+	REQUIRE(sched->latencies().execution.count == 9);
+}
+
+
+TEST_CASE("Latency scheduler released by its own task", "[Latency]") {
+	using namespace std::chrono_literals;
+	std::weak_ptr<scheduler_base> weak;
+	{
+		thread_pool_options options;
+		options.num_threads = 1;
+		auto sched = std::make_shared<latency_scheduler<thread_pool_scheduler>>(options);
+		weak = sched;
+		// Nothing else holds the view or the future, so the task's frame drops the last reference
+		// on the worker, while the probe that resumed it has yet to record.
+		sched->tagged("self")->schedule([] { std::this_thread::sleep_for(20ms); }).start();
+	}
+	for (size_t i = 0; i < 100 && !weak.expired(); ++i) {
+		std::this_thread::sleep_for(10ms);
+	}
+	REQUIRE(weak.expired());
+}
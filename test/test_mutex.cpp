@@ -1,8 +1,10 @@
 #include <catch.hpp>
 #include <cppjobs/future.hpp>
+#include <cppjobs/lock_profiler.hpp>
 #include <cppjobs/mutex.hpp>
 #include <cppjobs/shared_mutex.hpp>
 #include <iostream>
+#include <sstream>
 #include <thread>
 
 using namespace cppjobs;
@@ -71,4 +73,112 @@ TEST_CASE("Mutex hammer", "[Mutex]") {
 	REQUIRE(control == control.load());
 
 	std::ranges::for_each(threads, [](std::thread& thread) { thread.join(); });
-}
\ No newline at end of file
+}
+
+
+TEST_CASE("Mutex handed to a finished coroutine", "[Mutex]") {
+	// Like shared_mutex's lock coroutine: it finishes while holding the mutex, and the next
+	// coroutine of the same kind usually gets its frame, with the awaitable at the same address.
+	auto lock = [](mutex& mtx, bool& acquired) -> future<void> {
+		co_await mtx;
+		acquired = true;
+	};
+	mutex mtx;
+	REQUIRE(mtx.try_lock());
+	bool first_acquired = false;
+	{
+		auto first = lock(mtx, first_acquired);
+		first.start();
+		mtx.unlock();
+		first.get();
+	}
+	REQUIRE(first_acquired);
+
+	bool second_acquired = false;
+	auto second = lock(mtx, second_acquired);
+	second.start();
+	REQUIRE(!second_acquired);
+	mtx.unlock();
+	REQUIRE(second_acquired);
+	mtx.unlock();
+	second.get();
+	REQUIRE(!mtx._is_locked());
+}
+
+
+TEST_CASE("Named mutex lock/unlock cycle", "[Mutex]") {
+	auto task = []() -> future<void> {
+		mutex mtx{ "test/named" };
+		co_await mtx;
+		REQUIRE(mtx._is_locked());
+		REQUIRE(!mtx.try_lock());
+		mtx.unlock();
+		REQUIRE(mtx.try_lock());
+		mtx.unlock();
+		REQUIRE(!mtx._is_locked());
+	}();
+	task.get();
+
+	const auto stats = lock_profiler::snapshot();
+	const auto it = std::ranges::find(stats, std::string("test/named"), &lock_stats::name);
+	if constexpr (lock_profiler::enabled) {
+		REQUIRE(it != stats.end());
+		REQUIRE(it->acquisitions >= 2);
+		REQUIRE(it->unlocks >= 2);
+	}
+	else {
+		REQUIRE(it == stats.end());
+	}
+}
+
+
+#ifdef CPPJOBS_MUTEX_PROFILING
+TEST_CASE("Mutex profile contention", "[Mutex]") {
+	mutex mtx{ "test/contended" };
+	lock_profiler::reset();
+
+	struct gate {
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> handle) noexcept { m_handle = handle; }
+		void await_resume() const noexcept {}
+		std::coroutine_handle<> m_handle;
+	};
+	auto hold = [](mutex& mtx, gate& release) -> future<void> {
+		lock_guard<mutex> lk{ co_await mtx };
+		co_await release;
+	};
+	auto wait = [](mutex& mtx) -> future<void> {
+		lock_guard<mutex> lk{ co_await mtx };
+		co_return;
+	};
+
+	gate release;
+	auto holder = hold(mtx, release);
+	holder.start();
+	std::vector<future<void>> waiters;
+	for (int i = 0; i < 3; ++i) {
+		waiters.push_back(wait(mtx));
+		waiters.back().start();
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(2));
+	release.m_handle.resume();
+	holder.get();
+	for (auto& waiter : waiters) {
+		waiter.get();
+	}
+
+	const auto top = lock_profiler::top_contended(1);
+	REQUIRE(top.size() == 1);
+	REQUIRE(top[0].name == "test/contended");
+	REQUIRE(top[0].acquisitions == 4);
+	REQUIRE(top[0].contended == 3);
+	REQUIRE(top[0].unlocks == 4);
+	REQUIRE(top[0].max_wait >= std::chrono::milliseconds(2));
+	REQUIRE(top[0].waiters_walked > 0);
+	REQUIRE(top[0].hold_percentile(1.0) >= std::chrono::milliseconds(2));
+
+	std::stringstream report;
+	lock_profiler::report(report);
+	REQUIRE(report.str().find("test/contended") != std::string::npos);
+}
+#endif
@@ -0,0 +1,84 @@
+#include <catch.hpp>
+#include <cppjobs/parallel.hpp>
+#include <cppjobs/schedulers/debug_scheduler.hpp>
+#include <cppjobs/schedulers/immediate_scheduler.hpp>
+#include <cppjobs/schedulers/thread_pool_scheduler.hpp>
+
+#include <atomic>
+#include <numeric>
+#include <string>
+
+using namespace cppjobs;
+
+
+TEST_CASE("Parallel for visits each element once", "[Parallel]") {
+	auto sched = std::make_shared<thread_pool_scheduler>(thread_pool_options{ .num_threads = 4, .pinning = thread_pinning::none });
+	std::vector<std::atomic_int> visits(100000);
+	parallel_for(sched, std::views::iota(size_t(0), visits.size()), [&visits](size_t index) { ++visits[index]; }).get();
+	REQUIRE(std::ranges::all_of(visits, [](const std::atomic_int& count) { return count == 1; }));
+}
+
+
+TEST_CASE("Parallel for spreads over workers", "[Parallel]") {
+	auto sched = std::make_shared<thread_pool_scheduler>(thread_pool_options{ .num_threads = 4, .pinning = thread_pinning::none });
+	std::vector<std::atomic_int> used(sched->num_workers());
+	parallel_for(sched, std::views::iota(0, 200), [&](int) {
+		++used[sched->current_worker()];
+		std::this_thread::sleep_for(std::chrono::microseconds(100));
+	}).get();
+	REQUIRE(std::ranges::count_if(used, [](const std::atomic_int& count) { return count > 0; }) > 1);
+}
+
+
+TEST_CASE("Parallel for over container", "[Parallel]") {
+	auto sched = std::make_shared<thread_pool_scheduler>(thread_pool_options{ .num_threads = 4, .pinning = thread_pinning::none });
+	std::vector<int> values(10000, 1);
+	parallel_for(sched, values, [](int& value) { value *= 3; }, 16).get();
+	REQUIRE(std::ranges::all_of(values, [](int value) { return value == 3; }));
+}
+
+
+TEST_CASE("Parallel for on serial scheduler", "[Parallel]") {
+	// A scheduler that never needs work gets a single coroutine that runs the whole range.
+	auto sched = std::make_shared<debug_scheduler<immediate_scheduler>>();
+	int sum = 0;
+	parallel_for(sched, std::views::iota(1, 101), [&sum](int value) { sum += value; }).get();
+	REQUIRE(sum == 5050);
+	REQUIRE(sched->resume_count() == 1);
+}
+
+
+TEST_CASE("Parallel for exception", "[Parallel]") {
+	auto sched = std::make_shared<thread_pool_scheduler>(thread_pool_options{ .num_threads = 4, .pinning = thread_pinning::none });
+	auto fut = parallel_for(sched, std::views::iota(0, 10000), [](int value) {
+		if (value == 7777) {
+			throw std::runtime_error("bad element");
+		}
+	});
+	REQUIRE_THROWS_AS(fut.get(), std::runtime_error);
+}
+
+
+TEST_CASE("Parallel reduce", "[Parallel]") {
+	auto sched = std::make_shared<thread_pool_scheduler>(thread_pool_options{ .num_threads = 4, .pinning = thread_pinning::none });
+
+	SECTION("Sum") {
+		auto sum = parallel_reduce(sched, std::views::iota(int64_t(0), int64_t(1000000)), int64_t(0), std::plus<>{});
+		REQUIRE(sum.get() == int64_t(999999) * 1000000 / 2);
+	}
+	SECTION("Transform") {
+		std::vector<int> values(1000);
+		std::iota(values.begin(), values.end(), 0);
+		auto squares = parallel_reduce(sched, values, int64_t(0), std::plus<>{}, [](int value) { return int64_t(value) * value; });
+		REQUIRE(squares.get() == int64_t(999) * 1000 * 1999 / 6);
+	}
+	SECTION("Keeps order") {
+		auto digits = parallel_reduce(
+			sched, std::views::iota(0, 2000), std::string{}, std::plus<>{}, [](int value) { return std::to_string(value % 10); });
+		std::string expected;
+		for (int i = 0; i < 2000; ++i) {
+			expected += std::to_string(i % 10);
+		}
+		REQUIRE(digits.get() == expected);
+	}
+}
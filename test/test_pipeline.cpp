@@ -0,0 +1,114 @@
+#include <catch.hpp>
+#include <cppjobs/pipeline.hpp>
+#include <cppjobs/schedulers/immediate_scheduler.hpp>
+#include <cppjobs/schedulers/thread_pool_scheduler.hpp>
+
+#include <atomic>
+#include <string>
+
+using namespace cppjobs;
+
+
+static auto counter_source(int count) {
+	return [next = 0, count]() mutable -> std::optional<int> {
+		if (next == count) {
+			return std::nullopt;
+		}
+		return next++;
+	};
+}
+
+
+TEST_CASE("Pipeline keeps order at in-order stages", "[Pipeline]") {
+	auto sched = std::make_shared<thread_pool_scheduler>(thread_pool_options{ .num_threads = 4, .pinning = thread_pinning::none });
+	std::vector<std::string> written;
+	pipeline lines{
+		counter_source(1000),
+		stage(stage_mode::parallel, [](int value) { return value * 2; }),
+		stage(stage_mode::parallel, [](int value) { return std::to_string(value); }),
+		stage(stage_mode::serial_in_order, [&written](std::string line) { written.push_back(std::move(line)); }),
+	};
+	lines.run(sched, 8).get();
+	REQUIRE(written.size() == 1000);
+	for (int i = 0; i < 1000; ++i) {
+		REQUIRE(written[i] == std::to_string(i * 2));
+	}
+
+	// The pipeline can be run again, for which the source has to be reset.
+	written.clear();
+	lines.run(sched, 8).get();
+	REQUIRE(written.empty());
+}
+
+
+TEST_CASE("Pipeline bounds tokens in flight", "[Pipeline]") {
+	auto sched = std::make_shared<thread_pool_scheduler>(thread_pool_options{ .num_threads = 4, .pinning = thread_pinning::none });
+	std::atomic_int in_flight = 0;
+	std::atomic_int most_in_flight = 0;
+	std::atomic_int serial_inside = 0;
+	bool serial_overlapped = false;
+	int sum = 0;
+	pipeline counting{
+		[&in_flight, next = 0]() mutable -> std::optional<int> {
+			if (next == 500) {
+				return std::nullopt;
+			}
+			++in_flight;
+			return next++;
+		},
+		stage(stage_mode::parallel, [&](int value) {
+			int current = in_flight.load();
+			int most = most_in_flight.load();
+			while (current > most && !most_in_flight.compare_exchange_weak(most, current)) {
+			}
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+			return value;
+		}),
+		stage(stage_mode::serial_out_of_order, [&](int value) {
+			serial_overlapped |= ++serial_inside > 1;
+			sum += value;
+			--serial_inside;
+			--in_flight;
+		}),
+	};
+	counting.run(sched, 3).get();
+	REQUIRE(sum == 499 * 500 / 2);
+	REQUIRE(most_in_flight <= 3);
+	REQUIRE(!serial_overlapped);
+}
+
+
+TEST_CASE("Pipeline on serial scheduler", "[Pipeline]") {
+	auto sched = std::make_shared<immediate_scheduler>();
+	std::vector<int> written;
+	pipeline squares{
+		counter_source(100),
+		stage(stage_mode::parallel, [](int value) { return value * value; }),
+		stage(stage_mode::serial_in_order, [&written](int value) { written.push_back(value); }),
+	};
+	squares.run(sched, 4).get();
+	REQUIRE(written.size() == 100);
+	REQUIRE(written[99] == 99 * 99);
+}
+
+
+TEST_CASE("Pipeline exception", "[Pipeline]") {
+	auto sched = std::make_shared<thread_pool_scheduler>(thread_pool_options{ .num_threads = 4, .pinning = thread_pinning::none });
+	std::vector<int> written;
+	pipeline failing{
+		counter_source(1000),
+		stage(stage_mode::parallel, [](int value) {
+			if (value == 100) {
+				throw std::runtime_error("bad item");
+			}
+			return value;
+		}),
+		stage(stage_mode::serial_in_order, [&written](int value) { written.push_back(value); }),
+	};
+	REQUIRE_THROWS_AS(failing.run(sched, 8).get(), std::runtime_error);
+	// Once the failure is noticed, nothing else is written, but what was is still in order.
+	REQUIRE(written.size() <= 100);
+	for (size_t i = 0; i < written.size(); ++i) {
+		REQUIRE(written[i] == int(i));
+	}
+}
@@ -0,0 +1,140 @@
+#include <catch.hpp>
+#include <cppjobs/schedulers/debug_scheduler.hpp>
+#include <cppjobs/schedulers/immediate_scheduler.hpp>
+#include <cppjobs/schedulers/strand.hpp>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+using namespace cppjobs;
+
+
+/// <summary> Only resumes handles when told so, to observe what the strand hands over. </summary>
+class manual_scheduler : public scheduler {
+public:
+	size_t run() {
+		size_t count = 0;
+		while (true) {
+			std::coroutine_handle<> handle;
+			{
+				std::lock_guard lk(m_mtx);
+				if (m_handles.empty()) {
+					return count;
+				}
+				handle = m_handles.front();
+				m_handles.pop();
+			}
+			handle.resume();
+			++count;
+		}
+	}
+
+protected:
+	void queue_for_resume(std::coroutine_handle<> handle) override {
+		std::lock_guard lk(m_mtx);
+		m_handles.push(handle);
+	}
+
+private:
+	std::mutex m_mtx;
+	std::queue<std::coroutine_handle<>> m_handles;
+};
+
+
+TEST_CASE("Strand runs scheduled function", "[Strand]") {
+	auto underlying = std::make_shared<immediate_scheduler>();
+	auto serial = std::make_shared<strand>(underlying);
+	future<int> fut = serial->schedule([] { return 42; });
+	REQUIRE(fut.get() == 42);
+}
+
+
+TEST_CASE("Strand preserves FIFO order", "[Strand]") {
+	auto underlying = std::make_shared<manual_scheduler>();
+	auto serial = std::make_shared<debug_scheduler<strand>>(underlying);
+
+	std::vector<int> order;
+	std::vector<std::thread> threads;
+	for (int i = 0; i < 8; ++i) {
+		threads.push_back(std::thread([serial, &order, i] {
+			serial->schedule([&order, i] { order.push_back(i); }).get();
+		}));
+		while (serial->resume_count() != size_t(i + 1)) {
+			std::this_thread::yield();
+		}
+	}
+
+	REQUIRE(underlying->run() == 1); // A single drain task for all of them.
+	std::ranges::for_each(threads, [](std::thread& thread) { thread.join(); });
+	REQUIRE(order == std::vector<int>{ 0, 1, 2, 3, 4, 5, 6, 7 });
+}
+
+
+TEST_CASE("Strand batches respect limit", "[Strand]") {
+	auto underlying = std::make_shared<manual_scheduler>();
+	auto serial = std::make_shared<debug_scheduler<strand>>(underlying, 3);
+
+	std::vector<std::thread> threads;
+	for (int i = 0; i < 7; ++i) {
+		threads.push_back(std::thread([serial] {
+			serial->schedule([] {}).get();
+		}));
+	}
+	while (serial->resume_count() != 7) {
+		std::this_thread::yield();
+	}
+
+	REQUIRE(underlying->run() == 3);
+	std::ranges::for_each(threads, [](std::thread& thread) { thread.join(); });
+}
+
+
+TEST_CASE("Strand metrics", "[Strand]") {
+	auto underlying = std::make_shared<manual_scheduler>();
+	auto serial = std::make_shared<debug_scheduler<strand>>(underlying);
+
+	std::vector<future<int>> futures;
+	for (int i = 0; i < 5; ++i) {
+		futures.push_back(serial->schedule([i] { return i; }));
+		futures.back().start();
+	}
+	auto pending = serial->metrics();
+	REQUIRE(pending.queued == 5);
+	REQUIRE(pending.resumed == 0);
+	REQUIRE(pending.queue_length == 5);
+
+	underlying->run();
+	auto drained = serial->metrics();
+	REQUIRE(drained.queued == 5);
+	REQUIRE(drained.resumed == 5);
+	REQUIRE(drained.queue_length == 0);
+}
+
+
+TEST_CASE("Strand hammer", "[Strand]") {
+	auto underlying = std::make_shared<immediate_scheduler>();
+	auto serial = std::make_shared<strand>(underlying);
+	size_t value = 0;
+	std::atomic_bool inside = false;
+	std::atomic_bool overlapped = false;
+
+	std::vector<std::thread> threads;
+	const size_t num_threads = std::max(2u, std::thread::hardware_concurrency());
+	for (size_t i = 0; i < num_threads; ++i) {
+		threads.push_back(std::thread([&] {
+			for (size_t j = 0; j < 1000; ++j) {
+				serial->schedule([&] {
+					if (inside.exchange(true)) {
+						overlapped = true;
+					}
+					++value;
+					inside = false;
+				}).get();
+			}
+		}));
+	}
+	std::ranges::for_each(threads, [](std::thread& thread) { thread.join(); });
+
+	REQUIRE(!overlapped);
+	REQUIRE(value == num_threads * 1000);
+}
@@ -0,0 +1,108 @@
+#include <catch.hpp>
+#include <cppjobs/schedulers/debug_scheduler.hpp>
+#include <cppjobs/schedulers/immediate_scheduler.hpp>
+#include <cppjobs/schedulers/thread_pool_scheduler.hpp>
+#include <cppjobs/task_graph.hpp>
+
+#include <mutex>
+
+using namespace cppjobs;
+
+
+TEST_CASE("Task graph diamond", "[Task graph]") {
+	auto sched = std::make_shared<thread_pool_scheduler>(thread_pool_options{ .num_threads = 4, .pinning = thread_pinning::none });
+	std::mutex mtx;
+	std::vector<char> order;
+	auto record = [&](char name) {
+		return [&, name] {
+			std::lock_guard lk(mtx);
+			order.push_back(name);
+		};
+	};
+
+	task_graph graph;
+	const auto a = graph.add(record('a'));
+	const auto b = graph.add(record('b'));
+	const auto c = graph.add(record('c'));
+	const auto d = graph.add(record('d'));
+	graph.precede(a, b);
+	graph.precede(a, c);
+	graph.precede(b, d);
+	graph.precede(c, d);
+	REQUIRE(graph.size() == 4);
+
+	// Reruns reuse the same nodes.
+	for (int run = 0; run < 100; ++run) {
+		order.clear();
+		graph.run(sched).get();
+		REQUIRE(order.size() == 4);
+		REQUIRE(order.front() == 'a');
+		REQUIRE(order.back() == 'd');
+	}
+}
+
+
+TEST_CASE("Task graph resumes each node once", "[Task graph]") {
+	auto sched = std::make_shared<debug_scheduler<immediate_scheduler>>();
+	task_graph graph;
+	int sum = 0;
+	task_graph::node_id previous = graph.add([&sum] { sum += 1; });
+	for (int i = 2; i <= 10; ++i) {
+		const auto current = graph.add([&sum, i] { sum += i; });
+		graph.precede(previous, current);
+		previous = current;
+	}
+	graph.run(sched).get();
+	REQUIRE(sum == 55);
+	REQUIRE(sched->resume_count() == 10);
+}
+
+
+TEST_CASE("Task graph coroutine nodes", "[Task graph]") {
+	auto sched = std::make_shared<thread_pool_scheduler>(thread_pool_options{ .num_threads = 2, .pinning = thread_pinning::none });
+	std::atomic_int value = 0;
+	task_graph graph;
+	const auto first = graph.add([&value]() -> future<void> {
+		value = 1;
+		co_return;
+	});
+	const auto second = graph.add([&value]() -> future<int> {
+		value = value * 10;
+		co_return 0;
+	});
+	graph.precede(first, second);
+	graph.run(sched).get();
+	REQUIRE(value == 10);
+}
+
+
+TEST_CASE("Task graph exception", "[Task graph]") {
+	auto sched = std::make_shared<thread_pool_scheduler>(thread_pool_options{ .num_threads = 2, .pinning = thread_pinning::none });
+	bool after_ran = false;
+	task_graph graph;
+	const auto thrower = graph.add([] { throw std::runtime_error("node failed"); });
+	const auto after = graph.add([&after_ran] { after_ran = true; });
+	graph.precede(thrower, after);
+	REQUIRE_THROWS_AS(graph.run(sched).get(), std::runtime_error);
+	REQUIRE(!after_ran);
+	// The graph can run again after a failure.
+	REQUIRE_THROWS_AS(graph.run(sched).get(), std::runtime_error);
+}
+
+
+TEST_CASE("Task graph cycle", "[Task graph]") {
+	auto sched = std::make_shared<immediate_scheduler>();
+	task_graph graph;
+	const auto a = graph.add([] {});
+	const auto b = graph.add([] {});
+	graph.precede(a, b);
+	graph.precede(b, a);
+	REQUIRE_THROWS_AS(graph.run(sched).get(), std::logic_error);
+	REQUIRE_THROWS_AS(graph.precede(a, 5), std::out_of_range);
+}
+
+
+TEST_CASE("Task graph empty", "[Task graph]") {
+	task_graph graph;
+	graph.run(std::make_shared<immediate_scheduler>()).get();
+}
@@ -0,0 +1,439 @@
+#include <catch.hpp>
+#include <cppjobs/frame_arena.hpp>
+#include <cppjobs/schedulers/debug_scheduler.hpp>
+#include <cppjobs/schedulers/thread_pool_scheduler.hpp>
+#include <cppjobs/topology.hpp>
+#include <functional>
+#include <numeric>
+#include <thread>
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+using namespace cppjobs;
+
+
+static thread_pool_options two_node_options(size_t num_threads) {
+	thread_pool_options options;
+	options.num_threads = num_threads;
+	options.pinning = thread_pinning::none;
+	options.topology = { numa_node{ .id = 0, .cpus = { 0 } }, numa_node{ .id = 1, .cpus = { 0 } } };
+	return options;
+}
+
+
+TEST_CASE("Parse CPU list", "[Topology]") {
+	REQUIRE(parse_cpu_list("0-3,8,10-11\n") == std::vector<size_t>{ 0, 1, 2, 3, 8, 10, 11 });
+	REQUIRE(parse_cpu_list("5") == std::vector<size_t>{ 5 });
+	REQUIRE(parse_cpu_list("").empty());
+}
+
+
+TEST_CASE("System topology", "[Topology]") {
+	auto topology = system_topology();
+	REQUIRE(!topology.empty());
+	for (auto& node : topology) {
+		REQUIRE(!node.cpus.empty());
+	}
+}
+
+
+TEST_CASE("Thread pool schedule function", "[Thread pool]") {
+	auto sched = std::make_shared<thread_pool_scheduler>(thread_pool_options{ .num_threads = 2 });
+	REQUIRE(sched->num_workers() == 2);
+	future<ptrdiff_t> fut = sched->schedule([&sched] { return sched->current_worker(); });
+	const auto worker = fut.get();
+	REQUIRE(worker >= 0);
+	REQUIRE(worker < 2);
+	REQUIRE(sched->current_worker() == -1);
+}
+
+
+TEST_CASE("Thread pool awaits", "[Thread pool]") {
+	auto factorial = [](future<int> chain, int count) mutable -> future<int> {
+		int mul = 1;
+		if (chain.valid()) {
+			mul = co_await chain;
+		}
+		co_return count * mul;
+	};
+
+	auto sched = std::make_shared<thread_pool_scheduler>(two_node_options(4));
+	future<int> fut;
+	for (int i = 1; i <= 8; ++i) {
+		fut = sched->schedule(factorial, std::move(fut), i);
+	}
+	REQUIRE(fut.get() == 40320);
+}
+
+
+TEST_CASE("Thread pool fan out", "[Thread pool]") {
+	auto sched = std::make_shared<thread_pool_scheduler>(two_node_options(4));
+	REQUIRE(sched->num_nodes() == 2);
+
+	// Captureless, the closure is gone by the time the scheduled coroutine runs.
+	auto parent = [](thread_pool_scheduler* sched) -> future<size_t> {
+		auto child = [](size_t value) -> future<size_t> { co_return value; };
+		std::vector<future<size_t>> children;
+		for (size_t i = 0; i < 1000; ++i) {
+			children.push_back(sched->schedule(child, i));
+		}
+		size_t sum = 0;
+		for (auto& fut : children) {
+			sum += co_await fut;
+		}
+		co_return sum;
+	};
+	REQUIRE(sched->schedule(parent, sched.get()).get() == 999 * 1000 / 2);
+}
+
+
+TEST_CASE("Thread pool frames from node arena", "[Thread pool]") {
+	auto sched = std::make_shared<thread_pool_scheduler>(two_node_options(2));
+	auto arena = sched->schedule([] { return frame_arena::bound_arena(); }).get();
+	REQUIRE(arena != nullptr);
+	REQUIRE((arena == &frame_arena::for_node(0) || arena == &frame_arena::for_node(1)));
+	REQUIRE(frame_arena::bound_arena() == nullptr);
+}
+
+
+TEST_CASE("Thread pool released by its own task", "[Thread pool]") {
+	using namespace std::chrono_literals;
+	std::weak_ptr<scheduler_base> weak;
+	{
+		auto sched = std::make_shared<thread_pool_scheduler>(two_node_options(2));
+		weak = sched;
+		auto fut = sched->schedule([] { std::this_thread::sleep_for(20ms); });
+		sched.reset();
+		fut.wait();
+	}
+	// Whoever drops the last reference, worker or not, must be able to tear down the pool.
+	for (size_t i = 0; i < 100 && !weak.expired(); ++i) {
+		std::this_thread::sleep_for(10ms);
+	}
+	REQUIRE(weak.expired());
+}
+
+
+TEST_CASE("Thread pool explicit CPU set", "[Thread pool]") {
+	const size_t cpu = system_topology().front().cpus.front();
+	auto sched = std::make_shared<thread_pool_scheduler>(thread_pool_options{ .num_threads = 2, .cpus = { cpu }, .pinning = thread_pinning::cpu });
+	REQUIRE(sched->num_workers() == 2);
+#ifdef __linux__
+	auto running_on = sched->schedule([] { return sched_getcpu(); }).get();
+	REQUIRE(running_on == int(cpu));
+#endif
+}
+
+
+TEST_CASE("Thread pool unavailable CPU set", "[Thread pool]") {
+	REQUIRE_THROWS_AS(thread_pool_scheduler(thread_pool_options{ .cpus = { 1u << 20 } }), std::invalid_argument);
+}
+
+
+#ifdef __linux__
+TEST_CASE("Thread pool worker niceness", "[Thread pool]") {
+	// Raising niceness needs no privileges, unlike lowering it or real-time policies.
+	const int nice = std::min(getpriority(PRIO_PROCESS, 0) + 5, 19);
+	auto sched = std::make_shared<thread_pool_scheduler>(thread_pool_options{ .num_threads = 1, .policy = { .policy = scheduling_policy::batch, .nice = nice } });
+	auto [policy, priority] = sched->schedule([] {
+		return std::pair{ sched_getscheduler(0), getpriority(PRIO_PROCESS, gettid()) };
+	}).get();
+	REQUIRE(policy == SCHED_BATCH);
+	REQUIRE(priority == nice);
+}
+#endif
+
+
+TEST_CASE("Thread pool compensates blocked worker", "[Thread pool]") {
+	using namespace std::chrono_literals;
+	auto sched = std::make_shared<thread_pool_scheduler>(thread_pool_options{ .num_threads = 1, .pinning = thread_pinning::none, .max_threads = 2, .idle_timeout = 10ms });
+
+	// With a single worker, the waiter would block the setter out if the worker was not replaced.
+	std::atomic_bool flag = false;
+	auto waiter = sched->schedule([&flag] {
+		blocking_region region;
+		for (size_t i = 0; i < 500 && !flag; ++i) {
+			std::this_thread::sleep_for(10ms);
+		}
+		return region.compensated();
+	});
+	auto setter = sched->schedule([&flag] { flag = true; });
+
+	std::thread starter([&setter] {
+		std::this_thread::sleep_for(20ms);
+		setter.get();
+	});
+	REQUIRE(waiter.get());
+	starter.join();
+	REQUIRE(flag);
+	REQUIRE(sched->num_threads() <= 2);
+
+	// The blocked thread becomes a spare and times out.
+	for (size_t i = 0; i < 100 && sched->num_threads() > 1; ++i) {
+		std::this_thread::sleep_for(10ms);
+	}
+	REQUIRE(sched->num_threads() == 1);
+}
+
+
+TEST_CASE("Thread pool blocking region without room", "[Thread pool]") {
+	auto sched = std::make_shared<thread_pool_scheduler>(thread_pool_options{ .num_threads = 1, .pinning = thread_pinning::none });
+	auto compensated = sched->schedule([] {
+		blocking_region region;
+		return region.compensated();
+	});
+	REQUIRE(!compensated.get());
+	REQUIRE(!blocking_region{}.compensated());
+}
+
+
+TEST_CASE("Thread pool blocking region returns the worker", "[Thread pool]") {
+	using namespace std::chrono_literals;
+	auto sched = std::make_shared<thread_pool_scheduler>(thread_pool_options{ .num_threads = 1, .pinning = thread_pinning::none, .max_threads = 2, .idle_timeout = 10ms });
+
+	// The thread takes its worker back unless the compensating thread was quicker, which is rare with an empty region.
+	auto task = [](thread_pool_scheduler* sched) -> future<bool> {
+		{
+			blocking_region region;
+			// The thread of the previous region may still be on its way to the spares, and count against max_threads.
+			if (!region.compensated()) {
+				co_return false;
+			}
+			REQUIRE(sched->current_worker() == -1);
+		}
+		co_return sched->current_worker() == 0;
+	};
+	size_t returned = 0;
+	for (size_t i = 0; i < 20; ++i) {
+		returned += sched->schedule(task, sched.get()).get();
+	}
+	REQUIRE(returned > 0);
+
+	// Threads that found no worker to take over are spares, and time out.
+	for (size_t i = 0; i < 100 && sched->num_threads() > 1; ++i) {
+		std::this_thread::sleep_for(10ms);
+	}
+	REQUIRE(sched->num_threads() == 1);
+}
+
+
+TEST_CASE("Thread pool idle policies", "[Thread pool]") {
+	using namespace std::chrono_literals;
+	for (auto idle : { idle_policy::low_power(), idle_policy{}, idle_policy::low_latency() }) {
+		auto sched = std::make_shared<thread_pool_scheduler>(thread_pool_options{ .num_threads = 2, .pinning = thread_pinning::none, .idle = idle });
+		for (int i = 0; i < 20; ++i) {
+			// Gaps of varying length catch workers in every phase: spinning, yielding and parked.
+			std::this_thread::sleep_for(std::chrono::microseconds(i * i * 10));
+			REQUIRE(sched->schedule([i] { return i; }).get() == i);
+		}
+	}
+}
+
+
+TEST_CASE("Thread pool LIFO slot", "[Thread pool]") {
+	auto factorial = [](future<int> chain, int count) mutable -> future<int> {
+		int mul = 1;
+		if (chain.valid()) {
+			mul = co_await chain;
+		}
+		co_return count * mul;
+	};
+
+	for (size_t limit : { 0, 1, 16 }) {
+		auto sched = std::make_shared<thread_pool_scheduler>(thread_pool_options{ .num_threads = 2, .pinning = thread_pinning::none, .lifo_limit = limit });
+		future<int> fut;
+		for (int i = 1; i <= 8; ++i) {
+			fut = sched->schedule(factorial, std::move(fut), i);
+		}
+		REQUIRE(fut.get() == 40320);
+	}
+}
+
+
+TEST_CASE("Thread pool steals LIFO slot of blocked worker", "[Thread pool]") {
+	auto sched = std::make_shared<thread_pool_scheduler>(thread_pool_options{ .num_threads = 2, .pinning = thread_pinning::none });
+	// The child lands in the LIFO slot of the parent's worker, which then blocks on it.
+	auto parent = sched->schedule([&sched] {
+		auto child = sched->schedule([] { return 42; });
+		return child.get();
+	});
+	REQUIRE(parent.get() == 42);
+}
+
+
+TEST_CASE("Thread pool batch submission", "[Thread pool]") {
+	auto sched = std::make_shared<thread_pool_scheduler>(two_node_options(4));
+	std::vector<std::function<size_t()>> funcs;
+	for (size_t i = 0; i < 1000; ++i) {
+		funcs.push_back([i] { return i; });
+	}
+
+	SECTION("From outside the pool") {
+		auto futures = sched->schedule_batch(funcs);
+		REQUIRE(futures.size() == funcs.size());
+		size_t sum = 0;
+		for (auto& fut : futures) {
+			sum += fut.get();
+		}
+		REQUIRE(sum == 999 * 1000 / 2);
+	}
+	SECTION("From a worker") {
+		// Arguments live in the coroutine frame, unlike the captures of a temporary lambda.
+		auto sum = sched->schedule([](thread_pool_scheduler* sched, const std::vector<std::function<size_t()>>* funcs) -> future<size_t> {
+			size_t sum = 0;
+			for (auto& fut : sched->schedule_batch(*funcs)) {
+				sum += co_await fut;
+			}
+			co_return sum;
+		}, sched.get(), &funcs);
+		REQUIRE(sum.get() == 999 * 1000 / 2);
+	}
+	SECTION("Detached") {
+		std::atomic_size_t count = 0;
+		std::vector<std::function<void()>> increments(1000, [&count] { ++count; });
+		sched->schedule_batch(increments);
+		for (size_t i = 0; i < 1000 && count < 1000; ++i) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		REQUIRE(count == 1000);
+	}
+}
+
+
+TEST_CASE("Thread pool broadcast to waiters", "[Thread pool]") {
+	struct gate {
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> handle) { m_handle = handle; }
+		void await_resume() const noexcept {}
+		std::coroutine_handle<> m_handle;
+	};
+	gate release;
+	auto event = [](gate* release) -> future<int> {
+		co_await *release;
+		co_return 42;
+	}(&release).share();
+	event.start();
+
+	// Counts how the handles reach the pool.
+	struct counting_pool : thread_pool_scheduler {
+		using thread_pool_scheduler::thread_pool_scheduler;
+		void queue_for_resume(std::coroutine_handle<> handle) override {
+			++m_single;
+			thread_pool_scheduler::queue_for_resume(handle);
+		}
+		void queue_for_resume_batch(std::span<const std::coroutine_handle<>> handles) override {
+			++m_batches;
+			m_batched += handles.size();
+			thread_pool_scheduler::queue_for_resume_batch(handles);
+		}
+		std::atomic_size_t m_single = 0;
+		std::atomic_size_t m_batches = 0;
+		std::atomic_size_t m_batched = 0;
+	};
+	auto sched = std::make_shared<counting_pool>(two_node_options(4));
+	constexpr size_t num_waiters = 1000;
+	std::atomic_size_t arrived = 0;
+	auto waiter = [](shared_future<int> event, std::atomic_size_t* arrived) -> future<int> {
+		arrived->fetch_add(1);
+		co_return co_await event;
+	};
+	std::vector<future<int>> waiters;
+	for (size_t i = 0; i < num_waiters; ++i) {
+		waiters.push_back(sched->schedule(waiter, event, &arrived));
+		waiters.back().start();
+	}
+	while (arrived < num_waiters) {
+		std::this_thread::yield();
+	}
+	sched->m_single = 0;
+	sched->m_batches = 0;
+	sched->m_batched = 0;
+	release.m_handle.resume(); // Resumes all the waiters from this thread, which is not part of the pool.
+
+	size_t sum = 0;
+	for (auto& fut : waiters) {
+		sum += fut.get();
+	}
+	REQUIRE(sum == 42 * num_waiters);
+	// A waiter that arrived but hadn't suspended yet by the release doesn't need resuming.
+	REQUIRE(sched->m_single == 0);
+	REQUIRE(sched->m_batched > num_waiters / 2);
+	REQUIRE(sched->m_batches == (sched->m_batched + 63) / 64);
+}
+
+
+TEST_CASE("Thread pool debug scheduler counts broadcasts", "[Thread pool]") {
+	struct gate {
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> handle) { m_handle = handle; }
+		void await_resume() const noexcept {}
+		std::coroutine_handle<> m_handle;
+	};
+	gate release;
+	auto event = [](gate* release) -> future<int> {
+		co_await *release;
+		co_return 1;
+	}(&release).share();
+	event.start();
+
+	auto sched = std::make_shared<debug_scheduler<thread_pool_scheduler>>(two_node_options(4));
+	auto waiter = [](shared_future<int> event) -> future<int> {
+		co_return co_await event;
+	};
+	std::vector<future<int>> waiters;
+	for (size_t i = 0; i < 200; ++i) {
+		waiters.push_back(sched->schedule(waiter, event));
+		waiters.back().start();
+	}
+	while (sched->metrics().resumed < waiters.size()) {
+		std::this_thread::yield();
+	}
+	release.m_handle.resume();
+
+	size_t sum = 0;
+	for (auto& fut : waiters) {
+		sum += fut.get();
+	}
+	REQUIRE(sum == waiters.size());
+	// Every handle the pool was given went through the wrapper, the batched ones from the broadcast included.
+	REQUIRE(sched->resume_count() == sched->metrics().queued);
+	REQUIRE(sched->resume_count() > waiters.size());
+}
+
+TEST_CASE("Thread pool metrics", "[Thread pool]") {
+	auto sched = std::make_shared<thread_pool_scheduler>(two_node_options(2));
+	REQUIRE(sched->metrics().workers == 2);
+
+	std::vector<std::function<size_t()>> funcs(100, [] { return size_t(1); });
+	for (auto& fut : sched->schedule_batch(funcs)) {
+		fut.get();
+	}
+	auto fan_out = [](thread_pool_scheduler* sched) -> future<size_t> {
+		std::vector<future<size_t>> children;
+		for (size_t i = 0; i < 50; ++i) {
+			children.push_back(sched->schedule([] { return size_t(1); }));
+			children.back().start();
+		}
+		size_t sum = 0;
+		for (auto& child : children) {
+			sum += co_await child;
+		}
+		co_return sum;
+	};
+	REQUIRE(sched->schedule(fan_out, sched.get()).get() == 50);
+	std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+	const auto metrics = sched->metrics();
+	REQUIRE(metrics.queued_injected >= 101); // The batch and the parent.
+	REQUIRE(metrics.queued_local >= 50);
+	REQUIRE(metrics.queued == metrics.queued_local + metrics.queued_injected);
+	REQUIRE(metrics.resumed >= 151);
+	REQUIRE(metrics.max_queue_length > 0);
+	REQUIRE(metrics.idle.count() > 0);
+	REQUIRE(metrics.busy.count() > 0);
+	REQUIRE(metrics.queue_length == 0);
+}
@@ -0,0 +1,84 @@
+#include <catch.hpp>
+#include <cppjobs/schedulers/thread_pool_scheduler.hpp>
+#include <cppjobs/schedulers/tracing_scheduler.hpp>
+#include <cppjobs/trace.hpp>
+#include <sstream>
+#include <string>
+#include <thread>
+
+using namespace cppjobs;
+
+
+static size_t count_of(const std::string& text, const std::string& pattern) {
+	size_t count = 0;
+	for (size_t pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1)) {
+		++count;
+	}
+	return count;
+}
+
+
+TEST_CASE("Trace disabled", "[Trace]") {
+	tracer::clear();
+	auto coro = []() -> future<int> { co_return 1; };
+	REQUIRE(coro().get() == 1);
+	std::stringstream out;
+	tracer::write_chrome_trace(out);
+	REQUIRE(count_of(out.str(), "\"ph\"") == 0);
+}
+
+
+TEST_CASE("Trace coroutine lifecycle", "[Trace]") {
+	tracer::clear();
+	tracer::enable();
+	{
+		thread_pool_options options;
+		options.num_threads = 2;
+		auto sched = std::make_shared<tracing_scheduler<thread_pool_scheduler>>(options);
+		auto child = [](int value) -> future<int> { co_return value; };
+		std::vector<future<int>> futures;
+		for (int i = 0; i < 10; ++i) {
+			futures.push_back(sched->schedule(child, i));
+		}
+		int sum = 0;
+		for (auto& fut : futures) {
+			sum += fut.get();
+		}
+		REQUIRE(sum == 45);
+		// Let the workers drop their frames, so the pool is destroyed, and its threads stopped, right here.
+		futures.clear();
+		while (sched.use_count() > 1) {
+			std::this_thread::yield();
+		}
+	}
+	tracer::enable(false);
+
+	std::stringstream out;
+	tracer::write_chrome_trace(out);
+	const std::string trace = out.str();
+	REQUIRE(trace.starts_with("{\"traceEvents\":["));
+	REQUIRE(count_of(trace, "\"ph\":\"b\"") == 10);
+	REQUIRE(count_of(trace, "\"ph\":\"e\"") == 10);
+	REQUIRE(count_of(trace, "\"name\":\"start\"") == 10);
+	REQUIRE(count_of(trace, "\"name\":\"queue\"") >= 10);
+	REQUIRE(count_of(trace, "\"ph\":\"B\"") == count_of(trace, "\"ph\":\"E\""));
+	REQUIRE(count_of(trace, "\"ph\":\"B\"") >= 10);
+
+	// Written events are dropped.
+	std::stringstream again;
+	tracer::write_chrome_trace(again);
+	REQUIRE(count_of(again.str(), "\"ph\"") == 0);
+}
+
+
+TEST_CASE("Trace buffer overflow", "[Trace]") {
+	tracer::clear();
+	tracer::enable();
+	for (size_t i = 0; i < tracer::buffer_capacity + 100; ++i) {
+		tracer::record(trace_event::start, nullptr);
+	}
+	tracer::enable(false);
+	std::stringstream out;
+	tracer::write_chrome_trace(out);
+	REQUIRE(count_of(out.str(), "\"name\":\"start\"") == tracer::buffer_capacity);
+}